@@ -0,0 +1,86 @@
+#pragma once
+
+#include "esphome/core/automation.h"
+#include "esphome/core/helpers.h"
+#include "vl53l1x.h"
+
+namespace esphome {
+namespace vl53l1x {
+
+template<typename... Ts> class SetDistanceModeAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  TEMPLATABLE_VALUE(DistanceMode, distance_mode)
+
+  void play(Ts... x) override { this->parent_->request_distance_mode(this->distance_mode_.value(x...)); }
+};
+
+template<typename... Ts> class SetTimingBudgetAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  TEMPLATABLE_VALUE(uint16_t, timing_budget)
+
+  void play(Ts... x) override { this->parent_->request_timing_budget(this->timing_budget_.value(x...)); }
+};
+
+template<typename... Ts> class SetRoiAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, width)
+  TEMPLATABLE_VALUE(uint8_t, height)
+  TEMPLATABLE_VALUE(uint8_t, center)
+
+  void play(Ts... x) override {
+    this->parent_->request_roi(this->width_.value(x...), this->height_.value(x...), this->center_.value(x...));
+  }
+};
+
+template<typename... Ts> class SetThresholdsAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  TEMPLATABLE_VALUE(float, sigma_threshold)
+  TEMPLATABLE_VALUE(float, signal_threshold)
+
+  void play(Ts... x) override {
+    this->parent_->request_thresholds(this->sigma_threshold_.value(x...), this->signal_threshold_.value(x...));
+  }
+};
+
+template<typename... Ts> class CalibrateRoiAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  void play(Ts... x) override { this->parent_->request_roi_calibration(); }
+};
+
+template<typename... Ts> class ResetRoiCalibrationAction : public Action<Ts...>, public Parented<VL53L1XComponent> {
+ public:
+  void play(Ts... x) override { this->parent_->reset_roi_calibration(); }
+};
+
+class PresenceEnterTrigger : public Trigger<> {
+ public:
+  explicit PresenceEnterTrigger(VL53L1XComponent *parent) {
+    parent->add_on_presence_callback([this](PresenceDetector::Event event) {
+      if (event == PresenceDetector::ENTER)
+        this->trigger();
+    });
+  }
+};
+
+class PresenceLeaveTrigger : public Trigger<> {
+ public:
+  explicit PresenceLeaveTrigger(VL53L1XComponent *parent) {
+    parent->add_on_presence_callback([this](PresenceDetector::Event event) {
+      if (event == PresenceDetector::LEAVE)
+        this->trigger();
+    });
+  }
+};
+
+class PresenceDwellTrigger : public Trigger<> {
+ public:
+  explicit PresenceDwellTrigger(VL53L1XComponent *parent) {
+    parent->add_on_presence_callback([this](PresenceDetector::Event event) {
+      if (event == PresenceDetector::DWELL)
+        this->trigger();
+    });
+  }
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
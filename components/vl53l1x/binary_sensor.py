@@ -0,0 +1,37 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+import esphome.final_validate as fv
+from esphome.components import binary_sensor
+from esphome.const import DEVICE_CLASS_OCCUPANCY
+
+from .sensor import VL53L1XComponent, CONF_PRESENCE
+
+CODEOWNERS = ["@mrtoy-me"]
+
+CONF_VL53L1X_ID = "vl53l1x_id"
+
+CONFIG_SCHEMA = binary_sensor.binary_sensor_schema(
+    device_class=DEVICE_CLASS_OCCUPANCY,
+).extend(
+    {
+        cv.GenerateID(CONF_VL53L1X_ID): cv.use_id(VL53L1XComponent),
+    }
+)
+
+# presence is computed by the presence configuration of the vl53l1x sensor
+FINAL_VALIDATE_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_VL53L1X_ID): fv.id_declaration_match_schema(
+            cv.Schema(
+                {cv.Required(CONF_PRESENCE): cv.Schema({}, extra=cv.ALLOW_EXTRA)},
+                extra=cv.ALLOW_EXTRA,
+            )
+        ),
+    },
+    extra=cv.ALLOW_EXTRA,
+)
+
+async def to_code(config):
+    var = await binary_sensor.new_binary_sensor(config)
+    parent = await cg.get_variable(config[CONF_VL53L1X_ID])
+    cg.add(parent.set_presence_binary_sensor(var))
@@ -0,0 +1,73 @@
+#include "distance_mode_selector.h"
+
+namespace esphome {
+namespace vl53l1x {
+
+// frames in each window of statistics
+static const uint8_t SELECTOR_WINDOW = 16;
+// least time in a mode before switching again, as a switch costs a reconfiguration
+static const uint32_t SELECTOR_MODE_HOLD = 10000;  // ms
+
+// SHORT mode reaches about 1300mm, so valid distances beyond this or no target
+// at all suggest LONG, while in LONG mode targets closer than the lower
+// threshold are ranged faster and more reliably in SHORT
+static const uint16_t SELECTOR_FAR_DISTANCE  = 1100;  // mm
+static const uint16_t SELECTOR_NEAR_DISTANCE = 900;   // mm
+
+// LONG mode degrades badly in sunlight, switch to SHORT above the higher
+// ambient rate and only back to LONG below the lower one (9.7 format Mcps)
+static const uint16_t SELECTOR_AMBIENT_SHORT = 640;  // 5.0Mcps
+static const uint16_t SELECTOR_AMBIENT_LONG  = 320;  // 2.5Mcps
+
+void DistanceModeSelector::reset(uint32_t time_ms, bool long_mode) {
+  this->long_mode_ = long_mode;
+  this->mode_since_ = time_ms;
+  this->frames_ = 0;
+  this->near_frames_ = 0;
+  this->far_frames_ = 0;
+  this->ambient_sum_ = 0;
+}
+
+bool DistanceModeSelector::process(uint32_t time_ms, RangeStatus range_status, uint16_t distance_mm,
+                                   uint16_t ambient_rate) {
+  switch (range_status) {
+    case RANGE_VALID:
+    case RANGE_VALID_NOWRAP_CHECK_FAIL:
+    case RANGE_VALID_MIN_RANGE_CLIPPED:
+      if (distance_mm < SELECTOR_NEAR_DISTANCE)
+        this->near_frames_++;
+      else if (distance_mm > SELECTOR_FAR_DISTANCE)
+        this->far_frames_++;
+      break;
+    case SIGNAL_FAIL:
+    case OUT_OF_BOUNDS_FAIL:
+    case WRAP_TARGET_FAIL:
+      // nothing in range, possibly a target beyond the range of the mode
+      this->far_frames_++;
+      break;
+    default:
+      break;
+  }
+  this->ambient_sum_ += ambient_rate;
+  if (++this->frames_ < SELECTOR_WINDOW)
+    return false;
+
+  uint16_t ambient = this->ambient_sum_ / this->frames_;
+  this->ambient_mcps_ = ambient / 128.0f;
+  bool majority_near = (this->near_frames_ * 2) > this->frames_;
+  bool majority_far = (this->far_frames_ * 2) > this->frames_;
+  this->frames_ = 0;
+  this->near_frames_ = 0;
+  this->far_frames_ = 0;
+  this->ambient_sum_ = 0;
+
+  if ((time_ms - this->mode_since_) < SELECTOR_MODE_HOLD)
+    return false;
+
+  if (this->long_mode_)
+    return (ambient > SELECTOR_AMBIENT_SHORT) || majority_near;
+  return (ambient < SELECTOR_AMBIENT_LONG) && majority_far;
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,41 @@
+#pragma once
+
+// Automatic choice between SHORT and LONG distance mode from the measured
+// distance, ambient light and failed frames. Frames are evaluated in windows,
+// with separate thresholds in each direction and a minimum time in a mode so
+// it does not switch back and forth.
+
+#include "vl53l1x_calc.h"
+
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+class DistanceModeSelector {
+ public:
+  // start evaluating frames in long_mode (or short) at time_ms (millis())
+  void reset(uint32_t time_ms, bool long_mode);
+
+  // process one frame, ambient_rate is RESULT__AMBIENT_COUNT_RATE_MCPS_SD0 (9.7 format)
+  // returns true at the end of a window if the other distance mode should be used
+  bool process(uint32_t time_ms, RangeStatus range_status, uint16_t distance_mm, uint16_t ambient_rate);
+
+  bool is_long() const { return this->long_mode_; }
+  // mean ambient rate of the last complete window in Mcps
+  float get_ambient_mcps() const { return this->ambient_mcps_; }
+
+ protected:
+  bool long_mode_{true};
+  uint32_t mode_since_{0};
+  float ambient_mcps_{0};
+
+  // statistics of the window in progress
+  uint8_t frames_{0};
+  uint8_t near_frames_{0};
+  uint8_t far_frames_{0};
+  uint32_t ambient_sum_{0};
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,68 @@
+#include "kalman_tracker.h"
+
+namespace esphome {
+namespace vl53l1x {
+
+// restart tracking after a gap longer than this between samples
+static const float MAX_SAMPLE_INTERVAL = 10.0f;  // s
+
+// initial velocity uncertainty when tracking starts
+static const float INITIAL_VELOCITY_VARIANCE = 1.0e6f;  // (mm/s)^2
+
+// measurements further than this many standard deviations from the prediction
+// are rejected, tracking restarts after MAX_REJECTED consecutive rejections
+static const float OUTLIER_GATE_SQUARED = 25.0f;
+static const uint8_t MAX_REJECTED = 3;
+
+bool KalmanTracker::update(uint32_t time_us, float distance_mm, float sigma_mm) {
+  float measurement_variance = sigma_mm * sigma_mm;
+  float dt = (time_us - this->last_time_us_) * 1.0e-6f;
+
+  if (!this->initialised_ || (dt > MAX_SAMPLE_INTERVAL) || (this->rejected_ >= MAX_REJECTED)) {
+    this->distance_ = distance_mm;
+    this->velocity_ = 0.0f;
+    this->p00_ = measurement_variance;
+    this->p01_ = 0.0f;
+    this->p11_ = INITIAL_VELOCITY_VARIANCE;
+    this->last_time_us_ = time_us;
+    this->rejected_ = 0;
+    this->initialised_ = true;
+    return true;
+  }
+
+  this->predict(dt);
+  this->last_time_us_ = time_us;
+
+  float innovation = distance_mm - this->distance_;
+  float innovation_variance = this->p00_ + measurement_variance;
+  if ((innovation * innovation) > (OUTLIER_GATE_SQUARED * innovation_variance)) {
+    this->rejected_++;
+    return false;
+  }
+  this->rejected_ = 0;
+
+  float k0 = this->p00_ / innovation_variance;
+  float k1 = this->p01_ / innovation_variance;
+
+  this->distance_ += k0 * innovation;
+  this->velocity_ += k1 * innovation;
+
+  // P = (I - KH)P, using the prior p01 for p11
+  this->p11_ -= k1 * this->p01_;
+  this->p01_ -= k0 * this->p01_;
+  this->p00_ -= k0 * this->p00_;
+  return true;
+}
+
+// constant velocity prediction with white noise acceleration
+void KalmanTracker::predict(float dt) {
+  float dt2 = dt * dt;
+  this->distance_ += this->velocity_ * dt;
+
+  this->p00_ += dt * (2.0f * this->p01_ + dt * this->p11_) + this->acceleration_variance_ * dt2 * dt2 * 0.25f;
+  this->p01_ += dt * this->p11_ + this->acceleration_variance_ * dt2 * dt * 0.5f;
+  this->p11_ += this->acceleration_variance_ * dt2;
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,46 @@
+#pragma once
+
+// Constant velocity Kalman filter for timestamped distance samples.
+// Single precision float, a fixed number of operations per sample and no allocation.
+
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+class KalmanTracker {
+ public:
+  // process noise as the standard deviation of target acceleration in mm/s^2
+  void set_acceleration_noise(float acceleration_noise) {
+    this->acceleration_variance_ = acceleration_noise * acceleration_noise;
+  }
+
+  // update with a distance measurement and its standard deviation taken at time_us (micros())
+  // returns false if the measurement was rejected as an outlier
+  bool update(uint32_t time_us, float distance_mm, float sigma_mm);
+  void reset() { this->initialised_ = false; }
+
+  bool is_initialised() const { return this->initialised_; }
+  float get_distance() const { return this->distance_; }
+  // radial velocity in mm/s, negative when the target is approaching
+  float get_velocity() const { return this->velocity_; }
+
+ protected:
+  void predict(float dt);
+
+  float acceleration_variance_{1.0e6f};
+
+  // state and covariance
+  float distance_{0.0f};
+  float velocity_{0.0f};
+  float p00_{0.0f};
+  float p01_{0.0f};
+  float p11_{0.0f};
+
+  uint32_t last_time_us_{0};
+  uint8_t rejected_{0};
+  bool initialised_{false};
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
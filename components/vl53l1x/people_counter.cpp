@@ -0,0 +1,51 @@
+#include "people_counter.h"
+
+namespace esphome {
+namespace vl53l1x {
+
+PeopleCounter::Event PeopleCounter::process(uint8_t zone, bool occupied) {
+  if (zone >= PEOPLE_COUNTER_ZONES)
+    return NO_EVENT;
+
+  if (occupied == this->zone_occupied_[zone])
+    return NO_EVENT;
+  this->zone_occupied_[zone] = occupied;
+
+  uint8_t all_zones_status = (this->zone_occupied_[0] ? 1 : 0) | (this->zone_occupied_[1] ? 2 : 0);
+
+  if (this->path_track_size_ < 4)
+    this->path_track_size_++;
+
+  // someone is still in a zone, so record the path
+  if (all_zones_status != 0) {
+    this->path_track_[this->path_track_size_ - 1] = all_zones_status;
+    return NO_EVENT;
+  }
+
+  // both zones are empty again, a complete crossing passes through
+  // one zone, both zones then the other zone
+  Event event = NO_EVENT;
+  if (this->path_track_size_ == 4) {
+    if ((this->path_track_[1] == 1) && (this->path_track_[2] == 3) && (this->path_track_[3] == 2)) {
+      event = ENTRY;
+      this->entries_++;
+      this->occupancy_++;
+    } else if ((this->path_track_[1] == 2) && (this->path_track_[2] == 3) && (this->path_track_[3] == 1)) {
+      event = EXIT;
+      this->exits_++;
+      if (this->occupancy_ > 0)
+        this->occupancy_--;
+    }
+  }
+  this->path_track_size_ = 1;
+  return event;
+}
+
+void PeopleCounter::reset() {
+  this->path_track_size_ = 1;
+  this->zone_occupied_[0] = false;
+  this->zone_occupied_[1] = false;
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
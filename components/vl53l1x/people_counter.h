@@ -0,0 +1,45 @@
+#pragma once
+
+// Two zone people counting path tracker
+// based on the people counting example for the VL53L1X from STMicroelectronics (UM2600)
+
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+// zones are ranged alternately, a person crossing from zone 0 to zone 1 is an entry
+static const uint8_t PEOPLE_COUNTER_ZONES = 2;
+
+class PeopleCounter {
+ public:
+  enum Event : uint8_t {
+    NO_EVENT = 0,
+    ENTRY,
+    EXIT,
+  };
+
+  // process the occupied state of one zone, returns any crossing completed by this frame
+  Event process(uint8_t zone, bool occupied);
+  // forget a crossing in progress, the counts are kept
+  void reset();
+
+  uint32_t get_entries() const { return this->entries_; }
+  uint32_t get_exits() const { return this->exits_; }
+  // current occupancy, entries less exits but never below zero
+  uint32_t get_occupancy() const { return this->occupancy_; }
+
+ protected:
+  // path track holds the combined zone status (bit 0 = zone 0, bit 1 = zone 1)
+  // after each change, starting with both zones empty
+  uint8_t path_track_[4]{0, 0, 0, 0};
+  uint8_t path_track_size_{1};
+  bool zone_occupied_[PEOPLE_COUNTER_ZONES]{false, false};
+
+  uint32_t entries_{0};
+  uint32_t exits_{0};
+  uint32_t occupancy_{0};
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,54 @@
+#include "presence_detector.h"
+
+namespace esphome {
+namespace vl53l1x {
+
+PresenceDetector::Event PresenceDetector::process(uint32_t time_ms, bool target_detected, uint16_t distance_mm) {
+  // between the enter and leave distances the state is held
+  bool inside = target_detected && (distance_mm < this->enter_distance_);
+  bool outside = !target_detected || (distance_mm > this->leave_distance_);
+
+  if (!this->present_) {
+    if (!inside) {
+      this->changing_ = false;
+      return NO_EVENT;
+    }
+    if (!this->changing_) {
+      this->changing_ = true;
+      this->changing_since_ = time_ms;
+    }
+    if ((time_ms - this->changing_since_) < this->enter_delay_)
+      return NO_EVENT;
+
+    this->present_ = true;
+    this->changing_ = false;
+    this->dwell_done_ = false;
+    this->present_since_ = time_ms;
+    return ENTER;
+  }
+
+  if (outside) {
+    if (!this->changing_) {
+      this->changing_ = true;
+      this->changing_since_ = time_ms;
+    }
+    if ((time_ms - this->changing_since_) >= this->leave_delay_) {
+      this->present_ = false;
+      this->changing_ = false;
+      return LEAVE;
+    }
+    // a target that is leaving has not dwelt
+    return NO_EVENT;
+  } else {
+    this->changing_ = false;
+  }
+
+  if (!this->dwell_done_ && (this->dwell_time_ != 0) && ((time_ms - this->present_since_) >= this->dwell_time_)) {
+    this->dwell_done_ = true;
+    return DWELL;
+  }
+  return NO_EVENT;
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,53 @@
+#pragma once
+
+// Presence detection with distance hysteresis and minimum duration debouncing.
+// Evaluated for every frame so events are raised within one frame of the
+// debounce time elapsing.
+
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+class PresenceDetector {
+ public:
+  enum Event : uint8_t {
+    NO_EVENT = 0,
+    ENTER,
+    LEAVE,
+    DWELL,
+  };
+
+  // present when closer than enter_distance for enter_delay, absent when further than
+  // leave_distance (or nothing detected) for leave_delay, dwell after present for dwell_time
+  void configure(uint16_t enter_distance_mm, uint16_t leave_distance_mm, uint32_t enter_delay_ms,
+                 uint32_t leave_delay_ms, uint32_t dwell_time_ms) {
+    this->enter_distance_ = enter_distance_mm;
+    this->leave_distance_ = leave_distance_mm;
+    this->enter_delay_ = enter_delay_ms;
+    this->leave_delay_ = leave_delay_ms;
+    this->dwell_time_ = dwell_time_ms;
+  }
+
+  // process one frame at time_ms (millis()), target_detected is false when the
+  // frame found nothing in range, otherwise distance_mm is the measured distance
+  Event process(uint32_t time_ms, bool target_detected, uint16_t distance_mm);
+
+  bool is_present() const { return this->present_; }
+
+ protected:
+  uint16_t enter_distance_{0};
+  uint16_t leave_distance_{0};
+  uint32_t enter_delay_{0};
+  uint32_t leave_delay_{0};
+  uint32_t dwell_time_{0};
+
+  bool present_{false};
+  bool changing_{false};
+  bool dwell_done_{false};
+  uint32_t changing_since_{0};
+  uint32_t present_since_{0};
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
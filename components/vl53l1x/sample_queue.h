@@ -0,0 +1,103 @@
+#pragma once
+
+// Single producer single consumer lock-free queue of completed samples.
+// The producer (the code reading frames from the sensor) and the consumer
+// (the main loop) may run in different contexts, the only shared state is
+// the two indexes, each written by one side only.
+
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+// compact record of one completed frame, timestamps are micros()
+struct Sample {
+  uint32_t start_us;
+  uint32_t ready_us;
+  uint16_t distance_mm;
+  uint16_t sigma;          // RESULT__SIGMA_SD0, mm in 14.2 format
+  uint16_t ambient_rate;   // RESULT__AMBIENT_COUNT_RATE_MCPS_SD0, Mcps in 9.7 format
+  uint8_t range_status;    // RangeStatus
+};
+
+// packed little-endian record of a sample for export, independent of the host byte order
+//  0      sync byte SAMPLE_RECORD_SYNC
+//  1      sequence, incremented for each record so gaps show lost records
+//  2-5    start_us
+//  6-9    ready_us
+//  10-11  distance_mm
+//  12-13  sigma
+//  14-15  ambient_rate
+//  16     range_status
+//  17     checksum, the low byte of the sum of bytes 0 to 16
+static const uint8_t SAMPLE_RECORD_SIZE = 18;
+static const uint8_t SAMPLE_RECORD_SYNC = 0xA5;
+
+inline void encode_sample_record(const Sample &sample, uint8_t sequence, uint8_t *record) {
+  record[0] = SAMPLE_RECORD_SYNC;
+  record[1] = sequence;
+  for (uint8_t i = 0; i < 4; i++) {
+    record[2 + i] = sample.start_us >> (8 * i);
+    record[6 + i] = sample.ready_us >> (8 * i);
+  }
+  record[10] = sample.distance_mm;
+  record[11] = sample.distance_mm >> 8;
+  record[12] = sample.sigma;
+  record[13] = sample.sigma >> 8;
+  record[14] = sample.ambient_rate;
+  record[15] = sample.ambient_rate >> 8;
+  record[16] = sample.range_status;
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; i < SAMPLE_RECORD_SIZE - 1; i++)
+    checksum += record[i];
+  record[SAMPLE_RECORD_SIZE - 1] = checksum;
+}
+
+// must be a power of two, 32 frames is 320ms of back-to-back ranging with a 10ms timing budget
+static const uint16_t SAMPLE_QUEUE_SIZE = 32;
+
+class SampleQueue {
+ public:
+  // producer only, returns false and counts an overflow if the queue is full
+  bool push(const Sample &sample) {
+    uint32_t head = this->head_.load(std::memory_order_relaxed);
+    if ((head - this->tail_.load(std::memory_order_acquire)) >= SAMPLE_QUEUE_SIZE) {
+      this->overflows_.store(this->overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    this->samples_[head & (SAMPLE_QUEUE_SIZE - 1)] = sample;
+    this->head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, returns false if the queue is empty
+  bool pop(Sample *sample) {
+    uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (tail == this->head_.load(std::memory_order_acquire))
+      return false;
+    *sample = this->samples_[tail & (SAMPLE_QUEUE_SIZE - 1)];
+    this->tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, discard queued samples
+  void clear() { this->tail_.store(this->head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+  uint32_t size() const {
+    return this->head_.load(std::memory_order_acquire) - this->tail_.load(std::memory_order_acquire);
+  }
+
+  // samples dropped because the queue was full, since boot
+  uint32_t get_overflows() const { return this->overflows_.load(std::memory_order_relaxed); }
+
+ protected:
+  Sample samples_[SAMPLE_QUEUE_SIZE];
+  // free running counts of samples pushed and popped
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> overflows_{0};
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -1,17 +1,31 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import i2c, sensor
+import esphome.final_validate as fv
+from esphome import automation
+from esphome.components import i2c, sensor, uart
+from esphome.core import CORE
 from esphome.const import (
+    CONF_I2C_ID,
     CONF_ID,
+    CONF_INTERVAL,
+    CONF_PLATFORM,
     CONF_DISTANCE,
+    CONF_HEIGHT,
+    CONF_THRESHOLD,
+    CONF_TRIGGER_ID,
+    CONF_UART_ID,
     CONF_UPDATE_INTERVAL,
+    CONF_WIDTH,
     DEVICE_CLASS_DISTANCE,
+    DEVICE_CLASS_DURATION,
     STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_HERTZ,
     UNIT_MILLIMETER,
+    UNIT_MILLISECOND,
 )
 
 CODEOWNERS = ["@mrtoy-me"]
-DEPENDENCIES = ["i2c"]
 
 vl53l1x_ns = cg.esphome_ns.namespace("vl53l1x")
 
@@ -21,28 +35,248 @@ VL53L1XComponent = vl53l1x_ns.class_(
 
 DistanceMode = vl53l1x_ns.enum("DistanceMode")
 
+SetDistanceModeAction = vl53l1x_ns.class_("SetDistanceModeAction", automation.Action)
+SetTimingBudgetAction = vl53l1x_ns.class_("SetTimingBudgetAction", automation.Action)
+SetRoiAction = vl53l1x_ns.class_("SetRoiAction", automation.Action)
+SetThresholdsAction = vl53l1x_ns.class_("SetThresholdsAction", automation.Action)
+CalibrateRoiAction = vl53l1x_ns.class_("CalibrateRoiAction", automation.Action)
+ResetRoiCalibrationAction = vl53l1x_ns.class_("ResetRoiCalibrationAction", automation.Action)
+
+PresenceEnterTrigger = vl53l1x_ns.class_("PresenceEnterTrigger", automation.Trigger.template())
+PresenceLeaveTrigger = vl53l1x_ns.class_("PresenceLeaveTrigger", automation.Trigger.template())
+PresenceDwellTrigger = vl53l1x_ns.class_("PresenceDwellTrigger", automation.Trigger.template())
+
 DISTANCE_MODES = {
     "short": DistanceMode.SHORT,
     "long": DistanceMode.LONG, 
 }
 
+# switches between short and long from the measured distance and ambient light
+DISTANCE_MODE_AUTO = "auto"
+
+Preset = vl53l1x_ns.enum("Preset")
+
+PRESET_LOW_POWER = "low_power"
+PRESET_HIGH_RATE = "high_rate"
+
+PRESETS = {
+    PRESET_LOW_POWER: Preset.PRESET_LOW_POWER,
+    PRESET_HIGH_RATE: Preset.PRESET_HIGH_RATE,
+}
+
+# default, minimum and maximum timing budget in ms for each preset
+TIMING_BUDGETS = {
+    PRESET_LOW_POWER: (500, 20, 500),
+    PRESET_HIGH_RATE: (10, 10, 200),
+}
+
+# people counting ranges each zone in turn, so needs a short timing budget
+PEOPLE_COUNTER_TIMING_BUDGET = 20
+
+BurstAverage = vl53l1x_ns.enum("BurstAverage")
+
+BURST_AVERAGES = {
+    "median": BurstAverage.BURST_MEDIAN,
+    "trimmed_mean": BurstAverage.BURST_TRIMMED_MEAN,
+}
+
+# a burst ranges several short one-shots back to back for each update
+BURST_TIMING_BUDGET = 33
+
+# frames with a larger sigma estimate are SIGMA_FAIL and frames with a lower
+# return signal rate (in Mcps) are SIGNAL_FAIL, the defaults depend on the preset
+SIGMA_THRESHOLD_SCHEMA = cv.All(cv.distance, cv.Range(min=0.001, max=1.0))
+SIGNAL_THRESHOLD_SCHEMA = cv.float_range(min=0.01, max=100.0)
+
+CONF_ACCELERATION_NOISE = "acceleration_noise"
+CONF_AVERAGE = "average"
+CONF_BURST = "burst"
+CONF_CENTER = "center"
+CONF_COUNT = "count"
 CONF_DISTANCE_MODE = "distance_mode"
+CONF_DISTANCE_MODE_SWITCHES = "distance_mode_switches"
+CONF_DSS_TARGET_RATE = "dss_target_rate"
+CONF_DWELL_TIME = "dwell_time"
+CONF_ENTER_DELAY = "enter_delay"
+CONF_ENTER_DISTANCE = "enter_distance"
+CONF_ENTRY_COUNT = "entry_count"
+CONF_ENTRY_ROI_CENTER = "entry_roi_center"
+CONF_EXIT_COUNT = "exit_count"
+CONF_EXIT_ROI_CENTER = "exit_roi_center"
+CONF_FILTERED_DISTANCE = "filtered_distance"
+CONF_LEAVE_DELAY = "leave_delay"
+CONF_LEAVE_DISTANCE = "leave_distance"
+CONF_ON_DWELL = "on_dwell"
+CONF_ON_ENTER = "on_enter"
+CONF_ON_LEAVE = "on_leave"
+CONF_OCCUPANCY = "occupancy"
+CONF_ACQUISITION_TASK = "acquisition_task"
+CONF_AMPLITUDE = "amplitude"
+CONF_COMPLETION_LATENCY = "completion_latency"
+CONF_DROPOUT_PROBABILITY = "dropout_probability"
+CONF_ERROR_PROBABILITY = "error_probability"
+CONF_NOISE = "noise"
+CONF_PEOPLE_COUNTER = "people_counter"
+CONF_PERIOD = "period"
+CONF_PIPELINED = "pipelined"
+CONF_PRESENCE = "presence"
+CONF_PRESET = "preset"
 CONF_RANGE_STATUS = "range_status"
+CONF_RECALIBRATION = "recalibration"
+CONF_ROI_HEIGHT = "roi_height"
+CONF_ROI_WIDTH = "roi_width"
+CONF_SAMPLE_INTERVAL = "sample_interval"
+CONF_SAMPLE_JITTER = "sample_jitter"
+CONF_SAMPLE_EXPORT = "sample_export"
+CONF_SAMPLE_RATE = "sample_rate"
+CONF_SIGMA_FAIL_RATE = "sigma_fail_rate"
+CONF_SIGMA_INCREASE = "sigma_increase"
+CONF_SIGMA_THRESHOLD = "sigma_threshold"
+CONF_SIGNAL_FAIL_RATE = "signal_fail_rate"
+CONF_SIGNAL_THRESHOLD = "signal_threshold"
+CONF_SIMULATION = "simulation"
+CONF_SPEED = "speed"
+CONF_SPREAD = "spread"
+CONF_START_LATENCY = "start_latency"
+CONF_TIMING_BUDGET = "timing_budget"
+CONF_TRACKER = "tracker"
+CONF_VALID_DROP = "valid_drop"
+CONF_VALID_RATE = "valid_rate"
+CONF_VARIANT = "variant"
+CONF_VELOCITY = "velocity"
+CONF_WARM_START = "warm_start"
+
+UNIT_MILLIMETER_PER_SECOND = "mm/s"
+
+VARIANT_AUTO = "auto"
+VARIANT_VL53L1X = "vl53l1x"
+VARIANT_VL53L4CD = "vl53l4cd"
+
+# selecting a variant compiles out code paths only needed by the other sensor
+VARIANT_DEFINES = {
+    VARIANT_VL53L1X: "VL53L1X_VARIANT_VL53L1X",
+    VARIANT_VL53L4CD: "VL53L1X_VARIANT_VL53L4CD",
+}
+
+def validate_preset(config):
+    preset = config[CONF_PRESET]
+    if preset == PRESET_HIGH_RATE and config[CONF_VARIANT] == VARIANT_VL53L1X:
+        raise cv.Invalid(
+            "preset: high_rate is only supported by the VL53L4CD"
+        )
+    default_budget, min_budget, max_budget = TIMING_BUDGETS[preset]
+    if CONF_PEOPLE_COUNTER in config:
+        if preset != PRESET_LOW_POWER:
+            raise cv.Invalid(
+                "people_counter requires preset: low_power"
+            )
+        if CONF_TRACKER in config:
+            raise cv.Invalid(
+                "tracker cannot be used with people_counter"
+            )
+        default_budget = PEOPLE_COUNTER_TIMING_BUDGET
+    if CONF_BURST in config:
+        if preset != PRESET_LOW_POWER or CONF_PEOPLE_COUNTER in config:
+            raise cv.Invalid(
+                "burst requires preset: low_power and cannot be used with people_counter"
+            )
+        default_budget = BURST_TIMING_BUDGET
+    if config.get(CONF_PIPELINED):
+        if preset != PRESET_LOW_POWER or CONF_PEOPLE_COUNTER in config or CONF_BURST in config:
+            raise cv.Invalid(
+                "pipelined requires preset: low_power and cannot be used with people_counter or burst"
+            )
+    if CONF_TIMING_BUDGET not in config:
+        config[CONF_TIMING_BUDGET] = cv.positive_time_period_milliseconds(f"{default_budget}ms")
+    budget = config[CONF_TIMING_BUDGET].total_milliseconds
+    if not min_budget <= budget <= max_budget:
+        raise cv.Invalid(
+            f"timing_budget for preset: {preset} must be between {min_budget}ms and {max_budget}ms"
+        )
+    return config
+
+def validate_acquisition_task(config):
+    if not config.get(CONF_ACQUISITION_TASK):
+        return config
+    if not (CORE.is_esp32 or CORE.is_host):
+        raise cv.Invalid(
+            "acquisition_task is only supported on ESP32 and host"
+        )
+    if config[CONF_PRESET] != PRESET_HIGH_RATE:
+        raise cv.Invalid(
+            "acquisition_task requires preset: high_rate"
+        )
+    return config
+
+def count_i2c_devices(conf, bus_id):
+    # number of configurations anywhere in conf using the given I2C bus
+    if isinstance(conf, dict):
+        count = 1 if conf.get(CONF_I2C_ID) == bus_id else 0
+        return count + sum(count_i2c_devices(value, bus_id) for value in conf.values())
+    if isinstance(conf, list):
+        return sum(count_i2c_devices(item, bus_id) for item in conf)
+    return 0
+
+def validate_presence(config):
+    if CONF_LEAVE_DISTANCE not in config:
+        config[CONF_LEAVE_DISTANCE] = config[CONF_ENTER_DISTANCE] + 0.1
+    if config[CONF_LEAVE_DISTANCE] < config[CONF_ENTER_DISTANCE]:
+        raise cv.Invalid(
+            "leave_distance must be greater than or equal to enter_distance"
+        )
+    return config
 
 def validate_update_interval(config):
-    if config[CONF_UPDATE_INTERVAL].total_milliseconds < 1000:
+    # one-shot ranging must complete within the update interval
+    budget = config[CONF_TIMING_BUDGET].total_milliseconds
+    # unless ranging runs on its own, then it is only published at the update interval
+    minimum = budget if config[CONF_PRESET] == PRESET_HIGH_RATE or config.get(CONF_PIPELINED) else 2 * budget
+    if CONF_BURST in config:
+        minimum = (config[CONF_BURST][CONF_COUNT] + 1) * budget
+    if config[CONF_UPDATE_INTERVAL].total_milliseconds < minimum:
         raise cv.Invalid(
-            f"VL53L1X update_interval must be 1 second or greater. Increase update_interval to >= 1 second"
+            f"VL53L1X update_interval must be {minimum}ms or greater with timing_budget: {budget}ms"
         )
     return config
 
-CONFIG_SCHEMA = cv.All(
+def validate_distance_mode(config):
+    short_only = config[CONF_VARIANT] == VARIANT_VL53L4CD or config[CONF_PRESET] == PRESET_HIGH_RATE
+    if CONF_DISTANCE_MODE not in config:
+        default_mode = "short" if short_only else "long"
+        config[CONF_DISTANCE_MODE] = cv.enum(DISTANCE_MODES, upper=False)(default_mode)
+    if short_only and config[CONF_DISTANCE_MODE] != "short":
+        raise cv.Invalid(
+            "VL53L4CD only supports distance_mode: short"
+        )
+    if CONF_DISTANCE_MODE_SWITCHES in config and config[CONF_DISTANCE_MODE] != DISTANCE_MODE_AUTO:
+        raise cv.Invalid("distance_mode_switches requires distance_mode: auto")
+    return config
+
+VL53L1X_SCHEMA = (
     cv.Schema(   
         {
             cv.GenerateID(): cv.declare_id(VL53L1XComponent),
-            cv.Optional(CONF_DISTANCE_MODE, default="long"): cv.enum(
-                DISTANCE_MODES, upper=False
+            cv.Optional(CONF_VARIANT, default=VARIANT_AUTO): cv.one_of(
+                VARIANT_AUTO, VARIANT_VL53L1X, VARIANT_VL53L4CD, lower=True
+            ),
+            cv.Optional(CONF_DISTANCE_MODE): cv.Any(
+                cv.one_of(DISTANCE_MODE_AUTO, lower=True),
+                cv.enum(DISTANCE_MODES, upper=False),
+            ),
+            cv.Optional(CONF_DISTANCE_MODE_SWITCHES): sensor.sensor_schema(
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_TOTAL_INCREASING,
             ),
+            cv.Optional(CONF_PRESET, default=PRESET_LOW_POWER): cv.enum(
+                PRESETS, lower=True
+            ),
+            cv.Optional(CONF_TIMING_BUDGET): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_SIGMA_THRESHOLD): SIGMA_THRESHOLD_SCHEMA,
+            cv.Optional(CONF_SIGNAL_THRESHOLD): SIGNAL_THRESHOLD_SCHEMA,
+            cv.Optional(CONF_DSS_TARGET_RATE): cv.float_range(min=1.0, max=100.0),
+            cv.Optional(CONF_ACQUISITION_TASK): cv.boolean,
+            cv.Optional(CONF_PIPELINED): cv.boolean,
+            cv.Optional(CONF_WARM_START): cv.boolean,
             cv.Optional(CONF_DISTANCE): sensor.sensor_schema(
                 unit_of_measurement=UNIT_MILLIMETER,
                 accuracy_decimals=0,
@@ -53,17 +287,258 @@ CONFIG_SCHEMA = cv.All(
                 accuracy_decimals=0,
                 state_class=STATE_CLASS_MEASUREMENT,
             ),
+            cv.Optional(CONF_SAMPLE_RATE): sensor.sensor_schema(
+                unit_of_measurement=UNIT_HERTZ,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_VALID_RATE): sensor.sensor_schema(
+                unit_of_measurement=UNIT_HERTZ,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_SIGMA_FAIL_RATE): sensor.sensor_schema(
+                unit_of_measurement=UNIT_HERTZ,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_SIGNAL_FAIL_RATE): sensor.sensor_schema(
+                unit_of_measurement=UNIT_HERTZ,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_SAMPLE_INTERVAL): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                accuracy_decimals=2,
+                device_class=DEVICE_CLASS_DURATION,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_SAMPLE_JITTER): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                accuracy_decimals=2,
+                device_class=DEVICE_CLASS_DURATION,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_START_LATENCY): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                accuracy_decimals=2,
+                device_class=DEVICE_CLASS_DURATION,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            cv.Optional(CONF_COMPLETION_LATENCY): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MILLISECOND,
+                accuracy_decimals=2,
+                device_class=DEVICE_CLASS_DURATION,
+                state_class=STATE_CLASS_MEASUREMENT,
+            ),
+            # every sample as a binary record, for capture at the full sample rate
+            cv.Optional(CONF_SAMPLE_EXPORT): cv.Schema(
+                {
+                    cv.Required(CONF_UART_ID): cv.use_id(uart.UARTComponent),
+                }
+            ),
+            cv.Optional(CONF_RECALIBRATION): cv.Schema(
+                {
+                    # 0s only recalibrates when the frame statistics degrade
+                    cv.Optional(
+                        CONF_INTERVAL, default="1h"
+                    ): cv.positive_time_period_milliseconds,
+                    # 0% disables each degradation check
+                    cv.Optional(CONF_SIGMA_INCREASE, default="50%"): cv.percentage,
+                    cv.Optional(CONF_VALID_DROP, default="50%"): cv.percentage,
+                }
+            ),
+            cv.Optional(CONF_BURST): cv.Schema(
+                {
+                    cv.Optional(CONF_COUNT, default=5): cv.int_range(min=2, max=16),
+                    cv.Optional(CONF_AVERAGE, default="median"): cv.enum(
+                        BURST_AVERAGES, lower=True
+                    ),
+                    # difference between the largest and smallest valid distance
+                    cv.Optional(CONF_SPREAD): sensor.sensor_schema(
+                        unit_of_measurement=UNIT_MILLIMETER,
+                        accuracy_decimals=0,
+                        device_class=DEVICE_CLASS_DISTANCE,
+                        state_class=STATE_CLASS_MEASUREMENT,
+                    ),
+                }
+            ),
+            cv.Optional(CONF_TRACKER): cv.Schema(
+                {
+                    # standard deviation of target acceleration
+                    cv.Optional(CONF_ACCELERATION_NOISE, default=1000): cv.positive_float,
+                    cv.Optional(CONF_FILTERED_DISTANCE): sensor.sensor_schema(
+                        unit_of_measurement=UNIT_MILLIMETER,
+                        accuracy_decimals=0,
+                        device_class=DEVICE_CLASS_DISTANCE,
+                        state_class=STATE_CLASS_MEASUREMENT,
+                    ),
+                    cv.Optional(CONF_VELOCITY): sensor.sensor_schema(
+                        unit_of_measurement=UNIT_MILLIMETER_PER_SECOND,
+                        accuracy_decimals=0,
+                        state_class=STATE_CLASS_MEASUREMENT,
+                    ),
+                }
+            ),
+            cv.Optional(CONF_PRESENCE): cv.All(
+                cv.Schema(
+                    {
+                        cv.Required(CONF_ENTER_DISTANCE): cv.All(
+                            cv.distance, cv.Range(min=0.0, max=4.0)
+                        ),
+                        cv.Optional(CONF_LEAVE_DISTANCE): cv.All(
+                            cv.distance, cv.Range(min=0.0, max=4.0)
+                        ),
+                        cv.Optional(
+                            CONF_ENTER_DELAY, default="100ms"
+                        ): cv.positive_time_period_milliseconds,
+                        cv.Optional(
+                            CONF_LEAVE_DELAY, default="1s"
+                        ): cv.positive_time_period_milliseconds,
+                        cv.Optional(
+                            CONF_DWELL_TIME, default="10s"
+                        ): cv.positive_time_period_milliseconds,
+                        cv.Optional(CONF_ON_ENTER): automation.validate_automation(
+                            {
+                                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                                    PresenceEnterTrigger
+                                ),
+                            }
+                        ),
+                        cv.Optional(CONF_ON_LEAVE): automation.validate_automation(
+                            {
+                                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                                    PresenceLeaveTrigger
+                                ),
+                            }
+                        ),
+                        cv.Optional(CONF_ON_DWELL): automation.validate_automation(
+                            {
+                                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                                    PresenceDwellTrigger
+                                ),
+                            }
+                        ),
+                    }
+                ),
+                validate_presence,
+            ),
+            cv.Optional(CONF_PEOPLE_COUNTER): cv.Schema(
+                {
+                    cv.Required(CONF_THRESHOLD): cv.All(
+                        cv.distance, cv.Range(min=0.04, max=4.0)
+                    ),
+                    cv.Optional(CONF_ROI_WIDTH, default=8): cv.int_range(min=4, max=16),
+                    cv.Optional(CONF_ROI_HEIGHT, default=16): cv.int_range(min=4, max=16),
+                    cv.Optional(CONF_ENTRY_ROI_CENTER, default=167): cv.uint8_t,
+                    cv.Optional(CONF_EXIT_ROI_CENTER, default=231): cv.uint8_t,
+                    cv.Optional(CONF_ENTRY_COUNT): sensor.sensor_schema(
+                        accuracy_decimals=0,
+                        state_class=STATE_CLASS_TOTAL_INCREASING,
+                    ),
+                    cv.Optional(CONF_EXIT_COUNT): sensor.sensor_schema(
+                        accuracy_decimals=0,
+                        state_class=STATE_CLASS_TOTAL_INCREASING,
+                    ),
+                    cv.Optional(CONF_OCCUPANCY): sensor.sensor_schema(
+                        accuracy_decimals=0,
+                        state_class=STATE_CLASS_MEASUREMENT,
+                    ),
+                }
+            ),
         }
     )
     .extend(cv.polling_component_schema("60s"))
-    .extend(i2c.i2c_device_schema(0x29)),
+)
+
+SIMULATION_SCHEMA = cv.Schema(
+    {
+        # target distance, moving sinusoidally by amplitude over period
+        cv.Optional(CONF_DISTANCE, default="1m"): cv.All(
+            cv.distance, cv.Range(min=0.0, max=4.0)
+        ),
+        cv.Optional(CONF_AMPLITUDE, default="0m"): cv.All(
+            cv.distance, cv.Range(min=0.0, max=4.0)
+        ),
+        cv.Optional(CONF_PERIOD, default="10s"): cv.positive_time_period_milliseconds,
+        # standard deviation of the measured distance
+        cv.Optional(CONF_NOISE, default="0mm"): cv.All(
+            cv.distance, cv.Range(min=0.0, max=1.0)
+        ),
+        cv.Optional(CONF_DROPOUT_PROBABILITY, default=0.0): cv.zero_to_one_float,
+        cv.Optional(CONF_ERROR_PROBABILITY, default=0.0): cv.zero_to_one_float,
+        # simulated time runs this many times faster than real time
+        cv.Optional(CONF_SPEED, default=1.0): cv.float_range(min=0.1, max=100.0),
+    }
+)
+
+def validate_bus(config):
+    # a simulated sensor takes the place of the I2C bus, so it can run on the host platform
+    if CONF_SIMULATION in config:
+        return VL53L1X_SCHEMA.extend(
+            {cv.Required(CONF_SIMULATION): SIMULATION_SCHEMA}
+        )(config)
+    return VL53L1X_SCHEMA.extend(i2c.i2c_device_schema(0x29))(config)
+
+CONFIG_SCHEMA = cv.All(
+    validate_bus,
+    validate_preset,
     validate_update_interval,
+    validate_distance_mode,
+    validate_acquisition_task,
+)
+
+def final_validate_bus(config):
+    # i2c is only a dependency when the sensor is not simulated
+    if CONF_SIMULATION not in config and "i2c" not in fv.full_config.get():
+        raise cv.Invalid(
+            "VL53L1X requires an i2c: bus unless simulation is configured"
+        )
+    return config
+
+def final_validate_variant(config):
+    # the variant is a compile time selection, so it applies to every vl53l1x sensor
+    variants = {
+        conf.get(CONF_VARIANT, VARIANT_AUTO)
+        for conf in fv.full_config.get().get("sensor", [])
+        if conf.get(CONF_PLATFORM) == "vl53l1x"
+    }
+    if len(variants) > 1:
+        raise cv.Invalid(
+            f"All vl53l1x sensors must use the same variant, found {', '.join(sorted(variants))}",
+            path=[CONF_VARIANT],
+        )
+    return config
+
+FINAL_VALIDATE_SCHEMA = cv.All(
+    final_validate_bus,
+    final_validate_variant,
 )
 
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
-    await i2c.register_i2c_device(var, config)
+    if CONF_SIMULATION in config:
+        conf = config[CONF_SIMULATION]
+        cg.add_define("VL53L1X_SIMULATION")
+        # the simulated sensor is a VL53L4CD when the configuration needs one
+        vl53l4cd = config[CONF_VARIANT] == VARIANT_VL53L4CD or (
+            config[CONF_VARIANT] == VARIANT_AUTO and config[CONF_PRESET] == PRESET_HIGH_RATE
+        )
+        cg.add(
+            var.config_simulation(
+                vl53l4cd,
+                int(conf[CONF_DISTANCE] * 1000),
+                int(conf[CONF_AMPLITUDE] * 1000),
+                conf[CONF_PERIOD],
+                int(conf[CONF_NOISE] * 1000),
+                conf[CONF_DROPOUT_PROBABILITY],
+                conf[CONF_ERROR_PROBABILITY],
+                conf[CONF_SPEED],
+            )
+        )
+    else:
+        await i2c.register_i2c_device(var, config)
 
     if CONF_DISTANCE in config:
       sens = await sensor.new_sensor(config[CONF_DISTANCE])    
@@ -73,4 +548,257 @@ async def to_code(config):
         sens = await sensor.new_sensor(config[CONF_RANGE_STATUS])    
         cg.add(var.set_range_status_sensor(sens))
 
-    cg.add(var.config_distance_mode(config[CONF_DISTANCE_MODE]))
+    if CONF_SAMPLE_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_SAMPLE_RATE])
+        cg.add(var.set_sample_rate_sensor(sens))
+
+    if CONF_VALID_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_VALID_RATE])
+        cg.add(var.set_valid_rate_sensor(sens))
+
+    if CONF_SIGMA_FAIL_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_SIGMA_FAIL_RATE])
+        cg.add(var.set_sigma_fail_rate_sensor(sens))
+
+    if CONF_SIGNAL_FAIL_RATE in config:
+        sens = await sensor.new_sensor(config[CONF_SIGNAL_FAIL_RATE])
+        cg.add(var.set_signal_fail_rate_sensor(sens))
+
+    if CONF_SAMPLE_INTERVAL in config:
+        sens = await sensor.new_sensor(config[CONF_SAMPLE_INTERVAL])
+        cg.add(var.set_sample_interval_sensor(sens))
+
+    if CONF_SAMPLE_JITTER in config:
+        sens = await sensor.new_sensor(config[CONF_SAMPLE_JITTER])
+        cg.add(var.set_sample_jitter_sensor(sens))
+
+    if CONF_START_LATENCY in config:
+        sens = await sensor.new_sensor(config[CONF_START_LATENCY])
+        cg.add(var.set_start_latency_sensor(sens))
+
+    if CONF_COMPLETION_LATENCY in config:
+        sens = await sensor.new_sensor(config[CONF_COMPLETION_LATENCY])
+        cg.add(var.set_completion_latency_sensor(sens))
+
+    if CONF_PEOPLE_COUNTER in config:
+        conf = config[CONF_PEOPLE_COUNTER]
+        cg.add(
+            var.config_people_counter(
+                int(conf[CONF_THRESHOLD] * 1000),
+                conf[CONF_ROI_WIDTH],
+                conf[CONF_ROI_HEIGHT],
+                conf[CONF_ENTRY_ROI_CENTER],
+                conf[CONF_EXIT_ROI_CENTER],
+            )
+        )
+        if CONF_ENTRY_COUNT in conf:
+            sens = await sensor.new_sensor(conf[CONF_ENTRY_COUNT])
+            cg.add(var.set_entry_count_sensor(sens))
+        if CONF_EXIT_COUNT in conf:
+            sens = await sensor.new_sensor(conf[CONF_EXIT_COUNT])
+            cg.add(var.set_exit_count_sensor(sens))
+        if CONF_OCCUPANCY in conf:
+            sens = await sensor.new_sensor(conf[CONF_OCCUPANCY])
+            cg.add(var.set_occupancy_sensor(sens))
+
+    if CONF_SAMPLE_EXPORT in config:
+        cg.add_define("VL53L1X_SAMPLE_EXPORT")
+        uart_ = await cg.get_variable(config[CONF_SAMPLE_EXPORT][CONF_UART_ID])
+        cg.add(var.set_export_uart(uart_))
+
+    if CONF_RECALIBRATION in config:
+        conf = config[CONF_RECALIBRATION]
+        cg.add(
+            var.config_recalibration(
+                conf[CONF_INTERVAL], conf[CONF_SIGMA_INCREASE], conf[CONF_VALID_DROP]
+            )
+        )
+
+    if CONF_BURST in config:
+        conf = config[CONF_BURST]
+        cg.add(var.config_burst(conf[CONF_COUNT], conf[CONF_AVERAGE]))
+        if CONF_SPREAD in conf:
+            sens = await sensor.new_sensor(conf[CONF_SPREAD])
+            cg.add(var.set_burst_spread_sensor(sens))
+
+    if CONF_TRACKER in config:
+        conf = config[CONF_TRACKER]
+        cg.add(var.config_tracker(conf[CONF_ACCELERATION_NOISE]))
+        if CONF_FILTERED_DISTANCE in conf:
+            sens = await sensor.new_sensor(conf[CONF_FILTERED_DISTANCE])
+            cg.add(var.set_filtered_distance_sensor(sens))
+        if CONF_VELOCITY in conf:
+            sens = await sensor.new_sensor(conf[CONF_VELOCITY])
+            cg.add(var.set_velocity_sensor(sens))
+
+    if CONF_PRESENCE in config:
+        conf = config[CONF_PRESENCE]
+        cg.add(
+            var.config_presence(
+                int(conf[CONF_ENTER_DISTANCE] * 1000),
+                int(conf[CONF_LEAVE_DISTANCE] * 1000),
+                conf[CONF_ENTER_DELAY],
+                conf[CONF_LEAVE_DELAY],
+                conf[CONF_DWELL_TIME],
+            )
+        )
+        for trigger_conf in conf.get(CONF_ON_ENTER, []):
+            trigger = cg.new_Pvariable(trigger_conf[CONF_TRIGGER_ID], var)
+            await automation.build_automation(trigger, [], trigger_conf)
+        for trigger_conf in conf.get(CONF_ON_LEAVE, []):
+            trigger = cg.new_Pvariable(trigger_conf[CONF_TRIGGER_ID], var)
+            await automation.build_automation(trigger, [], trigger_conf)
+        for trigger_conf in conf.get(CONF_ON_DWELL, []):
+            trigger = cg.new_Pvariable(trigger_conf[CONF_TRIGGER_ID], var)
+            await automation.build_automation(trigger, [], trigger_conf)
+
+    if config[CONF_DISTANCE_MODE] == DISTANCE_MODE_AUTO:
+        # starts in long so distant targets are found
+        cg.add(var.config_distance_mode(DistanceMode.LONG))
+        cg.add(var.config_auto_distance_mode())
+        if CONF_DISTANCE_MODE_SWITCHES in config:
+            sens = await sensor.new_sensor(config[CONF_DISTANCE_MODE_SWITCHES])
+            cg.add(var.set_distance_mode_switches_sensor(sens))
+    else:
+        cg.add(var.config_distance_mode(config[CONF_DISTANCE_MODE]))
+    cg.add(var.config_preset(config[CONF_PRESET]))
+    if config.get(CONF_PIPELINED):
+        cg.add(var.config_pipelined())
+    if config.get(CONF_WARM_START):
+        cg.add(var.config_warm_start())
+    cg.add(var.config_timing_budget(config[CONF_TIMING_BUDGET].total_milliseconds))
+    # the preset defaults apply to any threshold not given
+    if CONF_SIGMA_THRESHOLD in config:
+        cg.add(var.config_sigma_threshold(config[CONF_SIGMA_THRESHOLD] * 1000))
+    if CONF_SIGNAL_THRESHOLD in config:
+        cg.add(var.config_signal_threshold(config[CONF_SIGNAL_THRESHOLD]))
+    if CONF_DSS_TARGET_RATE in config:
+        cg.add(var.config_dss_target_rate(config[CONF_DSS_TARGET_RATE]))
+
+    if config[CONF_VARIANT] in VARIANT_DEFINES:
+        cg.add_define(VARIANT_DEFINES[config[CONF_VARIANT]])
+
+    if config.get(CONF_ACQUISITION_TASK):
+        cg.add_define("VL53L1X_ACQUISITION_TASK")
+        # the task only needs to borrow the bus from the main loop if other devices use it
+        shared_bus = CONF_SIMULATION not in config and (
+            count_i2c_devices(CORE.config, config[CONF_I2C_ID]) > 1
+        )
+        cg.add(var.config_acquisition_task(shared_bus))
+
+
+@automation.register_action(
+    "vl53l1x.set_distance_mode",
+    SetDistanceModeAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(VL53L1XComponent),
+            cv.Required(CONF_DISTANCE_MODE): cv.templatable(
+                cv.enum(DISTANCE_MODES, upper=False)
+            ),
+        }
+    ),
+)
+async def set_distance_mode_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    template_ = await cg.templatable(config[CONF_DISTANCE_MODE], args, DistanceMode)
+    cg.add(var.set_distance_mode(template_))
+    return var
+
+
+@automation.register_action(
+    "vl53l1x.set_timing_budget",
+    SetTimingBudgetAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(VL53L1XComponent),
+            cv.Required(CONF_TIMING_BUDGET): cv.templatable(
+                cv.positive_time_period_milliseconds
+            ),
+        }
+    ),
+)
+async def set_timing_budget_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    template_ = await cg.templatable(
+        config[CONF_TIMING_BUDGET],
+        args,
+        cg.uint16,
+        to_exp=lambda x: x.total_milliseconds,
+    )
+    cg.add(var.set_timing_budget(template_))
+    return var
+
+
+@automation.register_action(
+    "vl53l1x.set_roi",
+    SetRoiAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(VL53L1XComponent),
+            cv.Required(CONF_WIDTH): cv.templatable(cv.int_range(min=4, max=16)),
+            cv.Required(CONF_HEIGHT): cv.templatable(cv.int_range(min=4, max=16)),
+            cv.Optional(CONF_CENTER, default=199): cv.templatable(cv.uint8_t),
+        }
+    ),
+)
+async def set_roi_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    template_ = await cg.templatable(config[CONF_WIDTH], args, cg.uint8)
+    cg.add(var.set_width(template_))
+    template_ = await cg.templatable(config[CONF_HEIGHT], args, cg.uint8)
+    cg.add(var.set_height(template_))
+    template_ = await cg.templatable(config[CONF_CENTER], args, cg.uint8)
+    cg.add(var.set_center(template_))
+    return var
+
+
+@automation.register_action(
+    "vl53l1x.set_thresholds",
+    SetThresholdsAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(VL53L1XComponent),
+            cv.Required(CONF_SIGMA_THRESHOLD): cv.templatable(SIGMA_THRESHOLD_SCHEMA),
+            cv.Required(CONF_SIGNAL_THRESHOLD): cv.templatable(SIGNAL_THRESHOLD_SCHEMA),
+        }
+    ),
+)
+async def set_thresholds_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    template_ = await cg.templatable(
+        config[CONF_SIGMA_THRESHOLD], args, cg.float_, to_exp=lambda x: x * 1000
+    )
+    cg.add(var.set_sigma_threshold(template_))
+    template_ = await cg.templatable(config[CONF_SIGNAL_THRESHOLD], args, cg.float_)
+    cg.add(var.set_signal_threshold(template_))
+    return var
+
+
+VL53L1X_ACTION_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.use_id(VL53L1XComponent),
+    }
+)
+
+
+@automation.register_action(
+    "vl53l1x.calibrate_roi", CalibrateRoiAction, VL53L1X_ACTION_SCHEMA
+)
+async def calibrate_roi_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "vl53l1x.reset_roi_calibration", ResetRoiCalibrationAction, VL53L1X_ACTION_SCHEMA
+)
+async def reset_roi_calibration_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
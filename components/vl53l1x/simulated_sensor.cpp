@@ -0,0 +1,256 @@
+#include "esphome/core/defines.h"
+
+// only built into configurations with simulation:
+#ifdef VL53L1X_SIMULATION
+
+#include "simulated_sensor.h"
+#include "vl53l1x_calc.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace vl53l1x {
+
+// registers modelled by the simulator
+static const uint16_t SOFT_RESET                            = 0x0000;
+static const uint16_t OSC_MEASURED__FAST_OSC__FREQUENCY     = 0x0006;
+static const uint16_t VHV_CONFIG__TIMEOUT_MACROP_LOOP_BOUND = 0x0008;
+static const uint16_t VHV_CONFIG__INIT                      = 0x000B;
+static const uint16_t GPIO_HV_MUX__CTRL                     = 0x0030;
+static const uint16_t GPIO__TIO_HV_STATUS                   = 0x0031;
+static const uint16_t RANGE_CONFIG__TIMEOUT_MACROP_A        = 0x005E;
+static const uint16_t RANGE_CONFIG__VCSEL_PERIOD_A          = 0x0060;
+static const uint16_t RANGE_CONFIG__TIMEOUT_MACROP_B        = 0x0061;
+static const uint16_t RANGE_CONFIG__VCSEL_PERIOD_B          = 0x0063;
+static const uint16_t SYSTEM__INTERRUPT_CLEAR               = 0x0086;
+static const uint16_t SYSTEM__MODE_START                    = 0x0087;
+static const uint16_t RESULT__RANGE_STATUS                  = 0x0089;
+static const uint16_t PHASECAL_RESULT__VCSEL_START          = 0x00D8;
+static const uint16_t RESULT__OSC_CALIBRATE_VAL             = 0x00DE;
+static const uint16_t FIRMWARE__SYSTEM_STATUS               = 0x00E5;
+static const uint16_t IDENTIFICATION__MODEL_ID              = 0x010F;
+
+// typical values read from a sensor after boot
+static const uint16_t FAST_OSC_FREQUENCY = 0xBCCC;  // 11.8MHz (4.12 format)
+static const uint16_t OSC_CALIBRATE_VAL  = 0x0440;
+static const uint8_t  VCSEL_START        = 0x0B;
+// VHV init enabled with its calibrated start value, and the VHV loop bound,
+// which the component saves with the first frame and restores when ranging stops
+static const uint8_t  VHV_INIT           = 0xA0;
+static const uint8_t  VHV_TIMEOUT        = 0x09;
+
+// frame overhead in addition to the range timeouts, as in the component
+static const uint32_t TIMING_GUARD           = 4528;  // us, low power auto
+static const uint32_t TIMING_GUARD_HIGH_RATE = 2500;  // us, back to back
+
+// maximum range of the long (VCSEL period A 0x0F) and short distance modes
+static const float MAX_RANGE_LONG  = 4000.0f;  // mm
+static const float MAX_RANGE_SHORT = 1300.0f;  // mm
+
+// device range status values written to RESULT__RANGE_STATUS
+static const uint8_t DEVICE_RANGECOMPLETE  = 9;
+static const uint8_t DEVICE_MSRCNOTARGET   = 4;
+static const uint8_t DEVICE_RANGEPHASECHECK = 5;
+
+SimulatedSensor::SimulatedSensor() { this->reset(); }
+
+void SimulatedSensor::set_model_id(uint16_t model_id) {
+  this->model_id_ = model_id;
+  this->set_register_16(IDENTIFICATION__MODEL_ID, model_id);
+}
+
+// registers as after boot, with ranging stopped
+void SimulatedSensor::reset() {
+  memset(this->registers_, 0, sizeof(this->registers_));
+  this->set_register_16(IDENTIFICATION__MODEL_ID, this->model_id_);
+  this->set_register_16(OSC_MEASURED__FAST_OSC__FREQUENCY, FAST_OSC_FREQUENCY);
+  this->set_register_16(RESULT__OSC_CALIBRATE_VAL, OSC_CALIBRATE_VAL);
+  this->registers_[PHASECAL_RESULT__VCSEL_START] = VCSEL_START;
+  this->registers_[VHV_CONFIG__INIT] = VHV_INIT;
+  this->registers_[VHV_CONFIG__TIMEOUT_MACROP_LOOP_BOUND] = VHV_TIMEOUT;
+  this->registers_[GPIO_HV_MUX__CTRL] = 0x10;  // interrupt active low
+  this->registers_[FIRMWARE__SYSTEM_STATUS] = 0x01;
+  this->mode_ = MODE_IDLE;
+  this->data_ready_ = false;
+  this->stream_count_ = 0;
+}
+
+bool SimulatedSensor::write(uint32_t now_us, uint16_t a_register, const uint8_t *data, uint8_t len) {
+  this->advance(now_us);
+  if ((this->error_probability_ > 0) &&
+      (std::uniform_real_distribution<float>(0, 1)(this->random_) < this->error_probability_))
+    return false;
+  if ((a_register + len) > SIMULATED_REGISTERS)
+    return false;
+
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t reg = a_register + i;
+    this->registers_[reg] = data[i];
+
+    switch (reg) {
+      case SOFT_RESET:
+        // the sensor boots when reset is released
+        if (data[i] & 0x01) {
+          this->reset();
+        }
+        else {
+          this->registers_[FIRMWARE__SYSTEM_STATUS] = 0x00;
+          this->mode_ = MODE_IDLE;
+        }
+        break;
+
+      case SYSTEM__INTERRUPT_CLEAR:
+        if (data[i] & 0x01)
+          this->data_ready_ = false;
+        break;
+
+      case SYSTEM__MODE_START:
+        if (data[i] & 0x80) {
+          this->mode_ = MODE_IDLE;
+        }
+        else if (data[i] & 0x10) {
+          this->mode_ = MODE_ONESHOT;
+          this->start_frame();
+        }
+        else if (data[i] & 0x60) {
+          // back to back (0x20) or timed (0x40), both range at the timing budget
+          this->mode_ = MODE_CONTINUOUS;
+          this->start_frame();
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+bool SimulatedSensor::read(uint32_t now_us, uint16_t a_register, uint8_t *data, uint8_t len) {
+  this->advance(now_us);
+  if ((this->error_probability_ > 0) &&
+      (std::uniform_real_distribution<float>(0, 1)(this->random_) < this->error_probability_))
+    return false;
+  if ((a_register + len) > SIMULATED_REGISTERS)
+    return false;
+
+  // interrupt is active low
+  this->registers_[GPIO__TIO_HV_STATUS] = this->data_ready_ ? 0x00 : 0x01;
+  memcpy(data, &this->registers_[a_register], len);
+  return true;
+}
+
+// move simulated time on to now_us, completing any frames which end before then
+void SimulatedSensor::advance(uint32_t now_us) {
+  if (this->started_)
+    this->time_us_ += static_cast<uint64_t>((now_us - this->last_now_us_) * this->speed_);
+  this->last_now_us_ = now_us;
+  this->started_ = true;
+
+  if ((this->mode_ == MODE_IDLE) || (this->time_us_ < this->frame_end_us_))
+    return;
+
+  this->complete_frame();
+  if (this->mode_ == MODE_ONESHOT) {
+    this->mode_ = MODE_IDLE;
+  }
+  else {
+    // a frame missed while results were not read is simply lost
+    uint32_t period_us = this->frame_period_us();
+    this->frame_end_us_ += period_us;
+    if (this->frame_end_us_ <= this->time_us_)
+      this->frame_end_us_ = this->time_us_ + period_us;
+  }
+}
+
+void SimulatedSensor::start_frame() {
+  this->data_ready_ = false;
+  this->frame_end_us_ = this->time_us_ + this->frame_period_us();
+}
+
+// frame period from the range timeouts written by the component
+uint32_t SimulatedSensor::frame_period_us() const {
+  uint16_t fast_osc_frequency = this->get_register_16(OSC_MEASURED__FAST_OSC__FREQUENCY);
+  uint32_t timeout_a_us = timeout_mclks_to_microseconds(
+      decode_timeout(this->get_register_16(RANGE_CONFIG__TIMEOUT_MACROP_A)),
+      calculate_macro_period(this->registers_[RANGE_CONFIG__VCSEL_PERIOD_A], fast_osc_frequency));
+  if (this->registers_[SYSTEM__MODE_START] & 0x20)
+    return timeout_a_us + TIMING_GUARD_HIGH_RATE;
+
+  // low power auto ranges with both timing A and timing B
+  uint32_t timeout_b_us = timeout_mclks_to_microseconds(
+      decode_timeout(this->get_register_16(RANGE_CONFIG__TIMEOUT_MACROP_B)),
+      calculate_macro_period(this->registers_[RANGE_CONFIG__VCSEL_PERIOD_B], fast_osc_frequency));
+  return timeout_a_us + timeout_b_us + TIMING_GUARD;
+}
+
+float SimulatedSensor::target_distance() const {
+  if ((this->amplitude_mm_ == 0) || (this->period_ms_ == 0))
+    return this->distance_mm_;
+  uint64_t period_us = static_cast<uint64_t>(this->period_ms_) * 1000;
+  float phase = static_cast<float>(this->time_us_ % period_us) / period_us;
+  return this->distance_mm_ + this->amplitude_mm_ * sinf(6.2831853f * phase);
+}
+
+// write the result block read by the component, in the same layout as RangingResults
+void SimulatedSensor::complete_frame() {
+  float distance = this->target_distance();
+  if (this->noise_mm_ != 0)
+    distance += std::normal_distribution<float>(0, this->noise_mm_)(this->random_);
+  if (distance < 0)
+    distance = 0;
+
+  float max_range = (this->registers_[RANGE_CONFIG__VCSEL_PERIOD_A] == 0x0F) ? MAX_RANGE_LONG : MAX_RANGE_SHORT;
+  bool dropout = (this->dropout_probability_ > 0) &&
+                 (std::uniform_real_distribution<float>(0, 1)(this->random_) < this->dropout_probability_);
+
+  uint8_t status = DEVICE_RANGECOMPLETE;
+  uint16_t signal_rate = 0x0400;  // 8Mcps (9.7 format)
+  if (dropout) {
+    status = DEVICE_MSRCNOTARGET;
+    signal_rate = 0x0010;
+    distance = 0;
+  }
+  else if (distance > max_range) {
+    status = DEVICE_RANGEPHASECHECK;
+    signal_rate = 0x0020;
+    distance = 0;
+  }
+
+  // the stream count wraps from 255 to 128 on the sensor
+  this->stream_count_ = (this->stream_count_ == 255) ? 128 : this->stream_count_ + 1;
+
+  // the component applies the range gain, so remove it here
+  uint16_t range_mm = static_cast<uint16_t>(distance * 2048.0f / 2011.0f + 0.5f);
+  uint16_t sigma = (this->noise_mm_ != 0) ? this->noise_mm_ * 4 : 4;  // 14.2 format
+
+  uint8_t *results = &this->registers_[RESULT__RANGE_STATUS];
+  results[0] = status;
+  results[1] = 0;
+  results[2] = this->stream_count_;
+  this->set_register_16(RESULT__RANGE_STATUS + 3, 0x2000);       // effective SPADs (8.8 format)
+  this->set_register_16(RESULT__RANGE_STATUS + 5, signal_rate);  // peak signal rate
+  this->set_register_16(RESULT__RANGE_STATUS + 7, 0x0040);       // ambient rate
+  this->set_register_16(RESULT__RANGE_STATUS + 9, sigma);
+  this->set_register_16(RESULT__RANGE_STATUS + 11, 0);           // phase
+  this->set_register_16(RESULT__RANGE_STATUS + 13, range_mm);
+  this->set_register_16(RESULT__RANGE_STATUS + 15, signal_rate);
+
+  this->data_ready_ = true;
+  this->frames_++;
+}
+
+uint16_t SimulatedSensor::get_register_16(uint16_t a_register) const {
+  return (static_cast<uint16_t>(this->registers_[a_register]) << 8) | this->registers_[a_register + 1];
+}
+
+void SimulatedSensor::set_register_16(uint16_t a_register, uint16_t value) {
+  this->registers_[a_register] = value >> 8;
+  this->registers_[a_register + 1] = value & 0xFF;
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+// Register level model of a VL53L1X or VL53L4CD, used in place of the I2C bus
+// so the component can run on the host platform.
+// Only the registers the component relies on behave like the sensor, every
+// other register simply stores what was written.
+
+#include <cstdint>
+#include <random>
+
+namespace esphome {
+namespace vl53l1x {
+
+// registers 0x0000 to 0x0FFF
+static const uint16_t SIMULATED_REGISTERS = 0x1000;
+
+class SimulatedSensor {
+ public:
+  SimulatedSensor();
+
+  void set_model_id(uint16_t model_id);
+  // target distance, optionally moving sinusoidally by amplitude_mm with the given period
+  void set_distance(uint16_t distance_mm) { this->distance_mm_ = distance_mm; }
+  void set_movement(uint16_t amplitude_mm, uint32_t period_ms) {
+    this->amplitude_mm_ = amplitude_mm;
+    this->period_ms_ = period_ms;
+  }
+  // standard deviation of the measured distance
+  void set_noise(uint16_t noise_mm) { this->noise_mm_ = noise_mm; }
+  // probability of a frame with no target (signal fail)
+  void set_dropout_probability(float probability) { this->dropout_probability_ = probability; }
+  // probability of a failed transaction
+  void set_error_probability(float probability) { this->error_probability_ = probability; }
+  // simulated time runs this many times faster than now_us
+  void set_speed(float speed) { this->speed_ = speed; }
+
+  // register access at time now_us, return false on a (simulated) failed transaction
+  bool write(uint32_t now_us, uint16_t a_register, const uint8_t *data, uint8_t len);
+  bool read(uint32_t now_us, uint16_t a_register, uint8_t *data, uint8_t len);
+
+  uint32_t get_frames() const { return this->frames_; }
+  // register contents without advancing time or injecting failures
+  uint8_t get_register(uint16_t a_register) const { return this->registers_[a_register]; }
+
+ protected:
+  enum Mode : uint8_t {
+    MODE_IDLE = 0,
+    MODE_ONESHOT,
+    MODE_CONTINUOUS,
+  };
+
+  void reset();
+  void advance(uint32_t now_us);
+  void complete_frame();
+  void start_frame();
+  uint32_t frame_period_us() const;
+  float target_distance() const;
+  uint16_t get_register_16(uint16_t a_register) const;
+  void set_register_16(uint16_t a_register, uint16_t value);
+
+  uint8_t registers_[SIMULATED_REGISTERS];
+
+  uint16_t model_id_{0xEACC};
+  uint16_t distance_mm_{1000};
+  uint16_t amplitude_mm_{0};
+  uint32_t period_ms_{10000};
+  uint16_t noise_mm_{0};
+  float dropout_probability_{0};
+  float error_probability_{0};
+  float speed_{1.0f};
+
+  // simulated time, so a sinusoidal target does not jump when micros() wraps
+  uint64_t time_us_{0};
+  uint32_t last_now_us_{0};
+  bool started_{false};
+
+  Mode mode_{MODE_IDLE};
+  uint64_t frame_end_us_{0};
+  bool data_ready_{false};
+  uint8_t stream_count_{0};
+  uint32_t frames_{0};
+
+  std::minstd_rand random_;
+};
+
+}  // namespace vl53l1x
+}  // namespace esphome
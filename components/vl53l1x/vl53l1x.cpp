@@ -46,6 +46,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "esphome/core/log.h"
 #include "esphome/core/hal.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef VL53L1X_ACQUISITION_TASK
+#ifndef USE_ESP32
+#include <chrono>
+#include <thread>
+#endif
+#endif
+
 namespace esphome {
 namespace vl53l1x {
 static const char *const TAG = "vl53l1x.sensor";
@@ -59,9 +70,20 @@ static const char *const TAG = "vl53l1x.sensor";
 //             = 1448 + 2100 + 980 = 4528
 static const uint32_t TIMING_GUARD = 4528;
 
+// TimingGuard value used by the high rate preset
+// VL53L4CD back-to-back continuous ranging has no low power phase between ranges,
+// so VL53L4CD_SetRangeTiming() in the VL53L4CD ULD subtracts a smaller overhead
+// and does not split the remaining budget between range timing A and B
+static const uint32_t TIMING_GUARD_HIGH_RATE = 2500;
+
 // value in DSS_CONFIG__TARGET_TOTAL_RATE_MCPS register, used in DSS calculations
+// tuning parm default (20Mcps), used unless a target rate is configured
 static const uint16_t TARGET_RATE  = 0x0A00;
 
+// DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT is only rewritten when the required
+// SPADs differ from the value last written by more than 1/16 (about 6%)
+static const uint8_t DSS_HYSTERESIS_SHIFT = 4;
+
 // register addresses from API vl53l1x_register_map.h
 enum regAddr : uint16_t
 {
@@ -1254,22 +1276,169 @@ enum regAddr : uint16_t
 };
 
 static const uint16_t BOOT_TIMEOUT     = 120;
-static const uint16_t TIMING_BUDGET    = 500;                          // timing budget is maximum allowable = 500 ms
-static const uint16_t RANGING_FINISHED = (TIMING_BUDGET * 115) / 100;  // add 15% extra to timing budget to ensure ranging is finished
+// smallest measurement standard deviation used by the tracker
+static const float TRACKER_MIN_SIGMA = 1.0f;  // mm
+
+// data ready polling, starts when a frame is expected to complete
+// the expected completion time is learned from previous frames of this sensor
+static const uint32_t DATAREADY_POLL_INTERVAL = 1000;    // us, minimum time between data ready checks
+static const uint32_t DATAREADY_TIMEOUT_MARGIN = 100000; // us, added to twice the timing budget
+
+// queued continuous ranging samples processed per loop
+static const uint8_t SAMPLE_BATCH = 8;
+
+#ifdef VL53L1X_ACQUISITION_TASK
+#ifdef USE_ESP32
+static const uint32_t ACQUISITION_TASK_STACK_SIZE = 4096;
+static const UBaseType_t ACQUISITION_TASK_PRIORITY = 5;  // above the main loop task
+#endif
+static const uint32_t BUS_REQUEST_POLL_INTERVAL = 100;   // us, host only
+static const uint32_t TASK_STOP_POLL_INTERVAL   = 10000; // us, host only
+static const uint32_t TASK_STOP_TIMEOUT         = 1000;  // ms, longer than a sensor reset
+#endif
+
+// RANGE_CONFIG__SIGMA_THRESH is in mm (14.2 format)
+// RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS is in Mcps (9.7 format)
+static const uint16_t SIGMA_THRESH             = 360;  // tuning parm default (90mm)
+static const uint16_t MIN_COUNT_RATE           = 192;  // tuning parm default (1.5Mcps)
+static const uint16_t SIGMA_THRESH_HIGH_RATE   = 60;   // VL53L4CD ULD default (15mm)
+static const uint16_t MIN_COUNT_RATE_HIGH_RATE = 128;  // VL53L4CD ULD default (1024kcps)
+
+// runtime threshold limits, as validated in sensor.py
+static const float SIGMA_THRESHOLD_MIN  = 1.0f;     // mm
+static const float SIGMA_THRESHOLD_MAX  = 1000.0f;  // mm
+static const float SIGNAL_THRESHOLD_MIN = 0.01f;    // Mcps
+static const float SIGNAL_THRESHOLD_MAX = 100.0f;   // Mcps
+
+// timing budget limits for each preset, as validated in sensor.py
+static const uint16_t TIMING_BUDGET_MIN           = 20;
+static const uint16_t TIMING_BUDGET_MAX           = 500;
+static const uint16_t TIMING_BUDGET_MIN_HIGH_RATE = 10;
+static const uint16_t TIMING_BUDGET_MAX_HIGH_RATE = 200;
 
 static const bool SET_ROI = true;
-static const uint8_t ROI_WIDTH = 4;
-static const uint8_t ROI_HEIGHT = 4;
+
+// RANGE_CONFIG__TIMEOUT_MACROP_A to RANGE_CONFIG__VALID_PHASE_HIGH hold the timing,
+// distance mode and thresholds, which go back to their defaults if the sensor resets
+// itself (for example on a brownout), so they are read back in one transaction
+static const uint16_t CONFIG_IMAGE_START    = RANGE_CONFIG__TIMEOUT_MACROP_A_HI;
+static const uint32_t CONFIG_CHECK_INTERVAL = 10000;  // ms
+
+// part of the configuration signature, change if init_sensor() writes a different configuration
+static const uint8_t WARM_START_VERSION = 1;
+
+// runtime reconfiguration requested by actions, applied from loop()
+static const uint8_t PENDING_DISTANCE_MODE = 0x01;
+static const uint8_t PENDING_TIMING_BUDGET = 0x02;
+static const uint8_t PENDING_ROI           = 0x04;
+static const uint8_t PENDING_RECALIBRATION = 0x08;
+static const uint8_t PENDING_THRESHOLDS    = 0x10;
+
+// recalibration of VHV and phasecal when frame statistics degrade, compared with
+// the first window of frames after the previous calibration
+static const uint16_t RECALIBRATION_WINDOW  = 32;     // frames in each window of statistics
+static const uint32_t RECALIBRATION_HOLDOFF = 60000;  // ms, least time between recalibrations on degradation
+
+// ROI alignment scan, square ROIs of each size centred on a grid around the
+// centre of the SPAD array (column 8, row 7), every candidate lies within the array
+static const uint8_t ROI_SCAN_SIZES[]   = {4, 6, 8};
+static const int8_t  ROI_SCAN_OFFSETS[] = {-4, -2, 0, 2, 4};
+static const uint8_t ROI_SCAN_COLUMN    = 8;
+static const uint8_t ROI_SCAN_ROW       = 7;
+static const uint8_t ROI_SCAN_GRID      = sizeof(ROI_SCAN_OFFSETS) * sizeof(ROI_SCAN_OFFSETS);
+// the configured ROI is ranged first, as the candidate others must beat
+static const uint8_t ROI_SCAN_CANDIDATES = 1 + sizeof(ROI_SCAN_SIZES) * ROI_SCAN_GRID;
+static const uint8_t  ROI_SCAN_FRAMES        = 4;     // scored frames per candidate, after one to settle DSS
+static const uint16_t ROI_SCAN_TIMING_BUDGET = 50;    // ms
+static const float    ROI_SCAN_MARGIN        = 1.1f;  // least improvement in score to replace the best ROI
+
+// communication failure recovery
+static const uint8_t  I2C_RETRIES          = 2;      // retries of a failed transaction before reporting failure
+static const uint32_t RECOVERY_BACKOFF_MIN = 100;    // ms, doubled after each failed recovery attempt
+static const uint32_t RECOVERY_BACKOFF_MAX = 10000;  // ms
 
 // Sensor Initialisation
 void VL53L1XComponent::setup() {
+  // until learned, expect frames to complete at the timing budget
+  this->completion_us_ = this->timing_budget_ * 1000;
+
+  // people counting sets the ROI of each zone itself
+  this->configured_roi_ = {this->roi_width_, this->roi_height_, this->roi_center_};
+  this->roi_pref_ =
+      global_preferences->make_preference<RoiCalibration>(this->preference_hash("vl53l1x_roi_calibration"));
+  RoiCalibration roi;
+  if (!this->people_counting_ && this->roi_pref_.load(&roi) && (roi.width >= 4) && (roi.width <= 16) &&
+      (roi.height >= 4) && (roi.height <= 16)) {
+    this->roi_width_ = roi.width;
+    this->roi_height_ = roi.height;
+    this->roi_center_ = roi.center;
+    this->roi_calibrated_ = true;
+  }
+
+  if (this->warm_start_) {
+    this->warm_start_pref_ =
+        global_preferences->make_preference<WarmStartRecord>(this->preference_hash("vl53l1x_warm_start"));
+    this->warm_started_ = this->warm_start();
+  }
+  if (!this->warm_started_ && !this->init_sensor()) {
+    this->mark_failed();
+    return;
+  }
+  this->last_calibration_time_ = millis();
+  this->setup_transactions_ = this->bus_transactions_;
+  this->setup_bytes_ = this->bus_bytes_;
+
+  // a VL53L4CD only ranges in SHORT mode
+  if (this->auto_distance_mode_ && this->is_vl53l4cd())
+    this->auto_distance_mode_ = false;
+  if (this->auto_distance_mode_)
+    this->distance_mode_selector_.reset(millis(), this->distance_mode_ == LONG);
+
+#ifdef USE_BINARY_SENSOR
+  if (this->presence_binary_sensor_ != nullptr)
+    this->presence_binary_sensor_->publish_initial_state(false);
+#endif
+
+  // high rate preset and people counting range continuously from now on,
+  // update() only publishes
+  if (this->free_running()) {
+    if (!this->start_ranging()) {
+      this->error_code_ = START_RANGING_FAILED;
+      this->mark_failed();
+      return;
+    }
+    this->last_update_time_ = millis();
+#ifdef VL53L1X_ACQUISITION_TASK
+    if (this->acquisition_task_) {
+      // the main loop only needs to run often to lend the bus
+      if (this->shared_bus_)
+        this->high_freq_.start();
+      if (!this->start_acquisition_task()) {
+        ESP_LOGE(TAG, "Failed to start acquisition task");
+        this->mark_failed();
+      }
+      return;
+    }
+#endif
+    this->high_freq_.start();
+  }
+}
+
+// reset and configure the sensor, also used to recover from communication failure
+// sets error_code_ and returns false on failure
+bool VL53L1XComponent::init_sensor() {
+  // soft reset returns the sensor to its default calibration
+  this->calibrated_ = false;
+  this->saved_vhv_init_ = 0;
+  this->saved_vhv_timeout_ = 0;
+  this->ranging_active_ = false;
+
   // try checking sensor id before reset
   bool valid_sensor = false;
   if (this->get_sensor_id(&valid_sensor)) {
     if (!valid_sensor) {
       this->error_code_ = WRONG_CHIP_ID;
-      this->mark_failed();
-      return;
+      return false;
     }
   }
 
@@ -1277,8 +1446,7 @@ void VL53L1XComponent::setup() {
   if (!this->vl53l1x_write_byte(SOFT_RESET, 0x00)) {
     ESP_LOGE(TAG, "Error writing soft reset 0");
     this->error_code_ = SOFT_RESET_FAILED;
-    this->mark_failed();
-    return;
+    return false;
   }
 
   delayMicroseconds(100);
@@ -1286,10 +1454,12 @@ void VL53L1XComponent::setup() {
   if (!this->vl53l1x_write_byte(SOFT_RESET, 0x01)) {
     ESP_LOGE(TAG, "Error writing soft reset 1");
     this->error_code_ = SOFT_RESET_FAILED;
-    this->mark_failed();
-    return;
+    return false;
   }
 
+  // registers are back to their defaults
+  this->config_image_written_ = 0;
+
   // give sensor time to boot
   delayMicroseconds(1200);
 
@@ -1299,16 +1469,18 @@ void VL53L1XComponent::setup() {
   while ((millis() - start_time) < BOOT_TIMEOUT ) {
     if (!this->boot_state(&state)) {
       this->error_code_ = BOOT_STATE_FAILED;
-      this->mark_failed();
-      return;
+      return false;
     }
     if (state) break;
+    // the main loop runs between polls rather than waiting out the boot,
+    // and between the register groups written below
+    if (!this->yield_bus())
+      return false;
   }
 
   if (!state) {
     this->error_code_ = BOOT_STATE_TIMEOUT;
-    this->mark_failed();
-    return;
+    return false;
   }
 
   // if getting sensor id failed prior to reset then try again
@@ -1316,11 +1488,15 @@ void VL53L1XComponent::setup() {
     this->get_sensor_id(&valid_sensor);
     if (!valid_sensor) {
       this->error_code_ = WRONG_CHIP_ID;
-      this->mark_failed();
-      return;
+      return false;
     }
   }
 
+  // resolved once, recovery finds the same sensor and must not change
+  // settings the main loop reads while the acquisition task recovers
+  if (!this->recovering_)
+    this->resolve_settings();
+
   bool ok = true;
   // sensor uses 1V8 mode for I/O by default
   // code examples by default switch to 2V8 mode
@@ -1338,7 +1514,7 @@ void VL53L1XComponent::setup() {
   // static config
   // API resets PAD_I2C_HV__EXTSUP_CONFIG here, but maybe we don't want to do that?
   // asit seems like it would disable 2V8 mode
-  if (ok) ok = this->vl53l1x_write_byte_16(DSS_CONFIG__TARGET_TOTAL_RATE_MCPS, TARGET_RATE);  // should already be this value after reset
+  if (ok) ok = this->vl53l1x_write_byte_16(DSS_CONFIG__TARGET_TOTAL_RATE_MCPS, this->dss_target_rate_);
   if (ok) ok = this->vl53l1x_write_byte(GPIO__TIO_HV_STATUS, 0x02);
   if (ok) ok = this->vl53l1x_write_byte(SIGMA_ESTIMATOR__EFFECTIVE_PULSE_WIDTH_NS, 8);        // tuning parm default
   if (ok) ok = this->vl53l1x_write_byte(SIGMA_ESTIMATOR__EFFECTIVE_AMBIENT_WIDTH_NS, 16);     // tuning parm default
@@ -1356,8 +1532,7 @@ void VL53L1XComponent::setup() {
   // timing config
   // most of these settings will be determined later by distance and timing
   // budget configuration
-  if (ok) ok = this->vl53l1x_write_byte_16(RANGE_CONFIG__SIGMA_THRESH, 360);                  // tuning parm default
-  if (ok) ok = this->vl53l1x_write_byte_16(RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS, 192); // tuning parm default
+  if (ok) ok = this->set_thresholds(this->sigma_threshold_, this->signal_threshold_);
 
   // dynamic config
   if (ok) ok = this->vl53l1x_write_byte(SYSTEM__GROUPED_PARAMETER_HOLD_0, 0x01);
@@ -1373,37 +1548,32 @@ void VL53L1XComponent::setup() {
   // from VL53L1_config_low_power_auto_mode
   if (ok) ok = this->vl53l1x_write_byte(SYSTEM__SEQUENCE_CONFIG, 0x8B);                       // VHV, PHASECAL, DSS1, RANGE
   if (ok) ok = this->vl53l1x_write_byte_16(DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, 200 << 8);
+  this->dss_spads_ = ok ? (200 << 8) : 0;
   if (ok) ok = this->vl53l1x_write_byte(DSS_CONFIG__ROI_MODE_CONTROL, 2);                     // REQUESTED_EFFFECTIVE_SPADS
 
   if (!ok) {
     this->error_code_ = CONFIG_FAILED;
-    this->mark_failed();
-    return;
-  }
-
-  // 0xEBAA = VL53L4CD must run with SHORT distance mode
-  if ((this->sensor_id_ == 0xEBAA) && (this->distance_mode_ == LONG)) {
-    this->distance_mode_ = SHORT;
-    this->distance_mode_overriden_ = true;
+    return false;
   }
+  if (!this->yield_bus())
+    return false;
 
   if (!this->set_distance_mode(this->distance_mode_)) {
     this->error_code_ = SET_MODE_FAILED;
-    this->mark_failed();
-    return;
+    return false;
   }
+  if (!this->yield_bus())
+    return false;
 
-  if (SET_ROI)
-    if (!this->set_roi_size(ROI_WIDTH, ROI_HEIGHT)) {
+  if (SET_ROI) {
+    if (!this->set_roi_size(this->roi_width_, this->roi_height_)) {
       this->error_code_ = SET_MODE_FAILED;
-      this->mark_failed();
-      return;
+      return false;
+    }
+    if ((this->roi_center_ != ROI_CENTER_DEFAULT) && !this->set_roi_center(this->roi_center_)) {
+      this->error_code_ = SET_MODE_FAILED;
+      return false;
     }
-
-  if (!this->set_timing_budget(TIMING_BUDGET)) {
-    this->error_code_ = SET_MODE_FAILED;
-    this->mark_failed();
-    return;
   }
 
   // the API triggers this change in VL53L1_init_and_start_range() once a
@@ -1413,12 +1583,163 @@ void VL53L1XComponent::setup() {
   if (ok) ok = this->vl53l1x_write_byte_16(ALGO__PART_TO_PART_RANGE_OFFSET_MM, offset * 4);
   if (!ok) {
     this->error_code_ = CONFIG_FAILED;
-    this->mark_failed();
+    return false;
+  }
+
+  // the record is complete once the first frame has saved the calibration
+  this->warm_start_record_pending_ = this->warm_start_;
+  return true;
+}
+
+// settings which depend on the sensor found, resolved before they are written
+void VL53L1XComponent::resolve_settings() {
+  // high rate preset relies on VL53L4CD back-to-back ranging
+  if ((this->preset_ == PRESET_HIGH_RATE) && !this->is_vl53l4cd()) {
+    this->preset_ = PRESET_LOW_POWER;
+    this->preset_overriden_ = true;
+    // the acquisition task only runs continuous ranging
+    this->acquisition_task_ = false;
+  }
+
+  // VL53L4CD must run with SHORT distance mode
+  if (this->is_vl53l4cd() && (this->distance_mode_ == LONG)) {
+    this->distance_mode_ = SHORT;
+    this->distance_mode_overriden_ = true;
+  }
+
+  // thresholds not configured take the defaults of the preset in use
+  if (this->sigma_threshold_ == 0)
+    this->sigma_threshold_ = (this->preset_ == PRESET_HIGH_RATE) ? SIGMA_THRESH_HIGH_RATE : SIGMA_THRESH;
+  if (this->signal_threshold_ == 0)
+    this->signal_threshold_ = (this->preset_ == PRESET_HIGH_RATE) ? MIN_COUNT_RATE_HIGH_RATE : MIN_COUNT_RATE;
+  if (this->dss_target_rate_ == 0)
+    this->dss_target_rate_ = TARGET_RATE;
+}
+
+// after a restart of only the MCU (OTA, watchdog, deep sleep) the sensor may
+// still hold the configuration it was left with, if so keep it rather than
+// resetting and reprogramming the sensor
+// returns false if the sensor has to be configured by init_sensor()
+bool VL53L1XComponent::warm_start() {
+  WarmStartRecord record;
+  if (!this->warm_start_pref_.load(&record) || (record.signature == 0))
+    return false;
+
+  bool valid_sensor = false;
+  uint8_t state = 0;
+  if (!this->get_sensor_id(&valid_sensor) || !valid_sensor || !this->boot_state(&state) || !state)
+    return false;
+  this->resolve_settings();
+  if (record.signature != this->config_signature()) {
+    ESP_LOGD(TAG, "Configuration changed since the sensor was configured, no warm start");
+    return false;
+  }
+
+  // a reset since the sensor was configured returns these to their defaults
+  uint8_t image[CONFIG_IMAGE_SIZE];
+  if (!this->vl53l1x_read_bytes(CONFIG_IMAGE_START, image, CONFIG_IMAGE_SIZE))
+    return false;
+  for (uint8_t i = 0; i < CONFIG_IMAGE_SIZE; i++) {
+    if ((record.image_written & (1 << i)) && (image[i] != record.image[i])) {
+      ESP_LOGD(TAG, "Sensor configuration lost, no warm start");
+      return false;
+    }
+  }
+
+  if (!this->vl53l1x_read_byte_16(OSC_MEASURED__FAST_OSC__FREQUENCY, &this->fast_osc_frequency_) ||
+      !this->vl53l1x_read_byte_16(RESULT__OSC_CALIBRATE_VAL, &this->osc_calibrate_val_))
+    return false;
+
+  // abort any ranging left running and restore the calibration overrides,
+  // so the first frame recalibrates as after a reset
+  this->saved_vhv_init_ = record.vhv_init;
+  this->saved_vhv_timeout_ = record.vhv_timeout;
+  if (!this->stop_continuous())
+    return false;
+  this->ranging_active_ = false;
+  this->dss_spads_ = 0;
+  memcpy(this->config_image_, record.image, CONFIG_IMAGE_SIZE);
+  this->config_image_written_ = record.image_written;
+  this->warm_start_record_ = record;
+  this->frame_budget_ms_ = this->timing_budget_;
+  ESP_LOGI(TAG, "Warm start, sensor configuration kept");
+  return true;
+}
+
+// of the settings written by init_sensor(), so a record of a different configuration is not used
+uint32_t VL53L1XComponent::config_signature() const {
+  const uint8_t settings[] = {
+      WARM_START_VERSION,
+      static_cast<uint8_t>(this->sensor_id_ >> 8),
+      static_cast<uint8_t>(this->sensor_id_),
+      static_cast<uint8_t>(this->preset_),
+      static_cast<uint8_t>(this->distance_mode_),
+      static_cast<uint8_t>(this->timing_budget_ >> 8),
+      static_cast<uint8_t>(this->timing_budget_),
+      this->roi_width_,
+      this->roi_height_,
+      this->roi_center_,
+      static_cast<uint8_t>(this->sigma_threshold_ >> 8),
+      static_cast<uint8_t>(this->sigma_threshold_),
+      static_cast<uint8_t>(this->signal_threshold_ >> 8),
+      static_cast<uint8_t>(this->signal_threshold_),
+      static_cast<uint8_t>(this->dss_target_rate_ >> 8),
+      static_cast<uint8_t>(this->dss_target_rate_),
+  };
+  uint32_t signature = fnv1_hash(std::string(reinterpret_cast<const char *>(settings), sizeof(settings)));
+  return (signature != 0) ? signature : 1;
+}
+
+// record the configuration the sensor holds, called once the first frame has
+// saved the calibration, the record is saved from the main loop
+void VL53L1XComponent::update_warm_start_record() {
+  LockGuard guard(this->config_lock_);
+  this->warm_start_record_pending_ = false;
+  this->warm_start_record_.signature = this->config_signature();
+  this->warm_start_record_.image_written = this->config_image_written_;
+  memcpy(this->warm_start_record_.image, this->config_image_, CONFIG_IMAGE_SIZE);
+  this->warm_start_record_.vhv_init = this->saved_vhv_init_;
+  this->warm_start_record_.vhv_timeout = this->saved_vhv_timeout_;
+  this->warm_start_save_ = true;
+}
+
+// the sensor no longer holds the configuration of the record, so the next
+// start configures it, a new record is only made when it is reset
+// called with config_lock_ held
+void VL53L1XComponent::invalidate_warm_start_record() {
+  this->warm_start_record_pending_ = false;
+  if (this->warm_start_record_.signature == 0)
     return;
+  this->warm_start_record_.signature = 0;
+  this->warm_start_save_ = true;
+}
+
+// start ranging for the configured mode, also used to recover from communication failure
+bool VL53L1XComponent::start_ranging() {
+  bool ok;
+  if (this->preset_ == PRESET_HIGH_RATE) {
+    ok = this->start_continuous(0);
+  }
+  else if (this->people_counting_) {
+    // people counting ranges back to back one-shots, alternating between zones
+    this->zone_ = 0;
+    ok = this->set_roi_center(this->zone_centre_[0]) && this->start_oneshot();
   }
+  else {
+    ok = this->start_oneshot();
+  }
+  if (!ok)
+    return false;
+
+  this->ranging_active_ = true;
+  this->frame_start_us_ = micros();
+  this->dataready_polls_ = 0;
+  return true;
 }
 
 void VL53L1XComponent::dump_config() {
+  // the settings reported may be changed by the acquisition task
+  LockGuard guard(this->config_lock_);
   ESP_LOGCONFIG(TAG, "VL53L1X:");
 
   switch (this->error_code_) {
@@ -1449,23 +1770,24 @@ void VL53L1XComponent::dump_config() {
     case START_RANGING_FAILED:
       ESP_LOGE(TAG, "  Start Ranging failed");
       break;
-    case SENSOR_READ_FAILED:
-      ESP_LOGE(TAG, " Sensor read process failed");
-      break;
     case NONE:
       ESP_LOGD(TAG, "  Setup successful");
 
       // no errors so sensor must be VL53L1X or VL53L4CD
-      if (this->sensor_id_ == 0xEACC) {
-        ESP_LOGI(TAG, "  Found sensor: VL53L1X");
-      }
-      if (this->sensor_id_ == 0xEBAA) {
+      if (this->is_vl53l4cd()) {
         ESP_LOGI(TAG,"  Found sensor: VL53L4CD");
       }
+      else {
+        ESP_LOGI(TAG, "  Found sensor: VL53L1X");
+      }
 
       if (this->distance_mode_overriden_) {
         ESP_LOGW(TAG, "  VL53L4CD Distance Mode overriden: must be SHORT");
       }
+      else if (this->auto_distance_mode_) {
+        ESP_LOGCONFIG(TAG, "  Distance Mode: AUTO (starting %s)", (this->distance_mode_ == SHORT) ? "SHORT" : "LONG");
+        LOG_SENSOR("  ", "Distance Mode Switches Sensor:", this->distance_mode_switches_sensor_);
+      }
       else {
         if (this->distance_mode_ == SHORT) {
           ESP_LOGCONFIG(TAG, "  Distance Mode: SHORT");
@@ -1474,128 +1796,1299 @@ void VL53L1XComponent::dump_config() {
           ESP_LOGCONFIG(TAG, "  Distance Mode: LONG");
         }
       }
-      ESP_LOGD(TAG, "  Timing Budget: %ims",TIMING_BUDGET);
+      if (this->preset_overriden_) {
+        ESP_LOGW(TAG, "  High rate preset requires VL53L4CD: using low power preset");
+      }
+      else if (this->preset_ == PRESET_HIGH_RATE) {
+        ESP_LOGCONFIG(TAG, "  Preset: HIGH RATE (continuous ranging)");
+      }
+      else if (this->pipelined_) {
+        ESP_LOGCONFIG(TAG, "  Preset: LOW POWER (pipelined one-shot ranging)");
+      }
+      else {
+        ESP_LOGCONFIG(TAG, "  Preset: LOW POWER (one-shot ranging)");
+      }
+      ESP_LOGD(TAG, "  Timing Budget: %ims",this->timing_budget_);
+#ifdef VL53L1X_SIMULATION
+      ESP_LOGCONFIG(TAG, "  Simulated sensor");
+#else
       LOG_I2C_DEVICE(this);
+#endif
       LOG_UPDATE_INTERVAL(this);
+      if (this->roi_calibrated_) {
+        ESP_LOGCONFIG(TAG, "  ROI: %ux%u center %u (from alignment scan)", this->roi_width_, this->roi_height_,
+                      this->roi_center_);
+      }
       LOG_SENSOR("  ", "Distance Sensor:", this->distance_sensor_);
       LOG_SENSOR("  ", "Range Status Sensor:", this->range_status_sensor_);
+      ESP_LOGCONFIG(TAG, "  Sigma threshold: %.2fmm, signal threshold: %.3fMcps", this->sigma_threshold_ / 4.0f,
+                    this->signal_threshold_ / 128.0f);
+      ESP_LOGCONFIG(TAG, "  DSS target rate: %.2fMcps", this->dss_target_rate_ / 128.0f);
+      LOG_SENSOR("  ", "Valid Rate Sensor:", this->valid_rate_sensor_);
+      LOG_SENSOR("  ", "Sigma Fail Rate Sensor:", this->sigma_fail_rate_sensor_);
+      LOG_SENSOR("  ", "Signal Fail Rate Sensor:", this->signal_fail_rate_sensor_);
+      ESP_LOGCONFIG(TAG, "  Recoveries since boot: %u, sensor configuration lost %u times", this->recovery_count_,
+                    this->config_losses_);
+      if (this->warm_start_)
+        ESP_LOGCONFIG(TAG, "  Warm start: %s", this->warm_started_ ? "configuration kept" : "sensor configured");
+      ESP_LOGCONFIG(TAG, "  Setup used %u I2C transactions (%u bytes)", this->setup_transactions_,
+                    this->setup_bytes_);
+      LOG_SENSOR("  ", "Sample Rate Sensor:", this->sample_rate_sensor_);
+      LOG_SENSOR("  ", "Sample Interval Sensor:", this->sample_interval_sensor_);
+      LOG_SENSOR("  ", "Sample Jitter Sensor:", this->sample_jitter_sensor_);
+      LOG_SENSOR("  ", "Start Latency Sensor:", this->start_latency_sensor_);
+      LOG_SENSOR("  ", "Completion Latency Sensor:", this->completion_latency_sensor_);
+#ifdef VL53L1X_ACQUISITION_TASK
+      if (this->acquisition_task_)
+        ESP_LOGCONFIG(TAG, "  Acquisition task: %s bus", this->shared_bus_ ? "shared" : "dedicated");
+#endif
+      if (this->recalibration_) {
+        ESP_LOGCONFIG(TAG, "  Recalibration: interval %ums, sigma increase %.0f%%, valid drop %.0f%%",
+                      this->recalibration_interval_, this->recalibration_sigma_increase_ * 100.0f,
+                      this->recalibration_valid_drop_ * 100.0f);
+      }
+      if (this->tracking_) {
+        ESP_LOGCONFIG(TAG, "  Tracker:");
+        LOG_SENSOR("    ", "Filtered Distance Sensor:", this->filtered_distance_sensor_);
+        LOG_SENSOR("    ", "Velocity Sensor:", this->velocity_sensor_);
+      }
+      if (this->burst_count_ != 0) {
+        ESP_LOGCONFIG(TAG, "  Burst: %u frames, %s", this->burst_count_,
+                      (this->burst_average_ == BURST_MEDIAN) ? "median" : "trimmed mean");
+        LOG_SENSOR("    ", "Spread Sensor:", this->burst_spread_sensor_);
+      }
+#ifdef USE_BINARY_SENSOR
+      LOG_BINARY_SENSOR("  ", "Presence Binary Sensor:", this->presence_binary_sensor_);
+#endif
+      if (this->people_counting_) {
+        ESP_LOGCONFIG(TAG, "  People Counter:");
+        ESP_LOGCONFIG(TAG, "    Threshold: %umm", this->people_threshold_);
+        ESP_LOGCONFIG(TAG, "    ROI: %ux%u, Zone Centres: %u, %u", this->roi_width_, this->roi_height_,
+                      this->zone_centre_[0], this->zone_centre_[1]);
+        LOG_SENSOR("    ", "Entry Count Sensor:", this->entry_count_sensor_);
+        LOG_SENSOR("    ", "Exit Count Sensor:", this->exit_count_sensor_);
+        LOG_SENSOR("    ", "Occupancy Sensor:", this->occupancy_sensor_);
+      }
 
       break;
    }
 }
 
 void VL53L1XComponent::loop() {
-  bool is_dataready;
-  // only run loop if not updating and every LOOP_TIME
-  if ((!this->ranging_active_) || ((millis() - this->last_loop_time_) < RANGING_FINISHED) || this->is_failed() )
+  if (this->is_failed())
     return;
 
-  if (!this->check_for_dataready(&is_dataready)) {
-    ESP_LOGD(TAG, "  Checking for data ready failed");
-    this->ranging_active_ = false;
+#ifdef VL53L1X_ACQUISITION_TASK
+  if (this->acquisition_task_) {
+    // the task ranges, recovers and reconfigures, the main loop
+    // lends it the bus and processes the samples it has read
+    if (this->recovering_ != this->status_has_warning()) {
+      if (this->recovering_) {
+        this->status_set_warning();
+        this->last_sample_ready_us_ = 0;
+      }
+      else {
+        this->status_clear_warning();
+      }
+    }
+    this->lend_bus();
+    this->drain_samples();
+    return;
+  }
+#endif
+
+  if (this->recovering_) {
+    if ((int32_t)(millis() - this->next_recovery_time_) >= 0)
+      this->recover();
+    return;
+  }
+
+  if (this->pending_config_ != 0) {
+    // let a one-shot in progress complete first
+    if (this->free_running() || !this->ranging_active_) {
+      if (!this->apply_pending_config())
+        this->start_recovery();
+      return;
+    }
+  }
+
+  if (this->preset_ == PRESET_HIGH_RATE) {
+    if (!this->read_continuous())
+      this->start_recovery();
+    this->drain_samples();
+    return;
+  }
+
+  // the scan starts once a one-shot in progress has completed and
+  // ranges on its own until every candidate ROI has been scored
+  if (this->roi_scan_requested_ && !this->ranging_active_) {
+    this->roi_scan_requested_ = false;
+    if (!this->start_roi_scan()) {
+      this->roi_scan_active_ = false;
+      this->start_recovery();
+    }
+    return;
+  }
+  if (this->roi_scan_active_) {
+    if (!this->roi_scan_step()) {
+      this->roi_scan_active_ = false;
+      this->start_recovery();
+    }
+    return;
+  }
+
+  if (this->people_counting_) {
+    if (!this->read_people_counter())
+      this->start_recovery();
     return;
   }
 
-  if (!is_dataready) {
-    ESP_LOGD(TAG, "  Data ready not ready when it should be!");
-    this->ranging_active_ = false;
+  if (this->pipelined_) {
+    if (!this->read_pipelined())
+      this->start_recovery();
+    return;
+  }
+
+  // only run loop if a one-shot is in progress
+  if (!this->ranging_active_)
+    return;
+
+  bool is_dataready;
+  if (!this->poll_dataready(&is_dataready)) {
+    ESP_LOGD(TAG, "  Checking for data ready failed");
+    this->start_recovery();
     return;
   }
 
+  if (!is_dataready)
+    return;
+
   // data ready now, so read and publish
   if (!this->perform_sensor_read()) {
-    this->error_code_ = SENSOR_READ_FAILED;
-    this->mark_failed();
+    this->start_recovery();
     return;
   }
 
-  ESP_LOGD(TAG, "Publishing Distance: %imm with Ranging status: %i",this->distance_,this->range_status_);
-  if (this->distance_sensor_ != nullptr)
-     this->distance_sensor_->publish_state(this->distance_);
-  if (this->range_status_sensor_ != nullptr)
-     this->range_status_sensor_->publish_state(this->range_status_);
+  // the next frame of a burst ranges while this one is processed
+  Sample sample = this->make_sample(this->frame_start_us_);
+  bool burst_next = (this->burst_count_ != 0) && ((this->burst_frames_ + 1) < this->burst_count_);
+  if (burst_next && !this->start_next_oneshot()) {
+    this->start_recovery();
+    return;
+  }
+
+  this->process_sample(sample);
+
+  // keep ranging until the burst is complete
+  if ((this->burst_count_ != 0) && !this->add_burst_sample())
+    return;
+
+  this->publish_results();
 
   this->ranging_active_ = false;
 }
 
 void VL53L1XComponent::update() {
+  uint32_t now = millis();
+  if (this->warm_start_save_) {
+    this->warm_start_save_ = false;
+    WarmStartRecord record;
+    {
+      LockGuard guard(this->config_lock_);
+      record = this->warm_start_record_;
+    }
+    if (!this->warm_start_pref_.save(&record))
+      ESP_LOGW(TAG, "Failed to save warm start record");
+  }
+  if (this->sample_rate_sensor_ != nullptr) {
+    uint32_t elapsed = now - this->last_update_time_;
+    if ((this->last_update_time_ != 0) && (elapsed > 0))
+      this->sample_rate_sensor_->publish_state(this->sample_count_ * 1000.0f / elapsed);
+  }
+  this->sample_count_ = 0;
+  this->publish_status_counts((this->last_update_time_ != 0) ? now - this->last_update_time_ : 0);
+  this->last_update_time_ = now;
+  this->publish_sample_interval();
+  uint16_t timing_budget;
+  {
+    LockGuard guard(this->config_lock_);
+    timing_budget = this->timing_budget_;
+  }
+  ESP_LOGV(TAG, "Frame completion %uus with timing budget %ums", this->completion_us_.load(), timing_budget);
+  uint32_t transactions = this->bus_transactions_;
+  uint32_t bytes = this->bus_bytes_;
+  ESP_LOGV(TAG, "I2C: %u transactions (%u bytes) since the previous update, %u failed since boot, %u DSS writes skipped",
+           transactions - this->reported_transactions_, bytes - this->reported_bytes_, this->bus_failures_.load(),
+           this->dss_writes_skipped_.exchange(0));
+  this->reported_transactions_ = transactions;
+  this->reported_bytes_ = bytes;
+  uint32_t overflows = this->sample_queue_.get_overflows();
+  if (overflows != this->reported_overflows_) {
+    ESP_LOGW(TAG, "Sample queue full, %u samples dropped since the previous update", overflows - this->reported_overflows_);
+    this->reported_overflows_ = overflows;
+  }
+  if (this->distance_mode_switches_ != this->reported_distance_mode_switches_) {
+    ESP_LOGI(TAG, "Distance mode switched %u times since the previous update (%u since boot), last switch took %uus",
+             this->distance_mode_switches_ - this->reported_distance_mode_switches_, this->distance_mode_switches_,
+             this->distance_mode_switch_us_);
+    this->reported_distance_mode_switches_ = this->distance_mode_switches_;
+  }
+  if (this->distance_mode_switches_sensor_ != nullptr)
+    this->distance_mode_switches_sensor_->publish_state(this->distance_mode_switches_);
+  if (this->tracking_) {
+    ESP_LOGV(TAG, "Tracker maximum processing time %uus, %u outliers rejected", this->tracker_us_max_,
+             this->tracker_rejections_);
+    this->tracker_us_max_ = 0;
+    this->tracker_rejections_ = 0;
+  }
+
+  // nothing to start or publish until communication is restored
+  if (this->recovering_)
+    return;
+
+  if (this->recalibration_ && (this->recalibration_interval_ != 0) &&
+      ((millis() - this->last_calibration_time_) >= this->recalibration_interval_))
+    this->request_recalibration("interval");
+
+  // high rate preset and people counting range continuously, just publish the latest sample
+  if (this->free_running()) {
+    if (this->new_sample_)
+      this->publish_results();
+    if (this->people_counting_) {
+      ESP_LOGD(TAG, "People counter: maximum zone processing time %uus", this->zone_process_us_max_);
+      this->zone_process_us_max_ = 0;
+      this->publish_people_counts();
+    }
+    return;
+  }
+
+  // nothing is published while the ROI alignment scan runs
+  if (this->roi_scan_requested_ || this->roi_scan_active_)
+    return;
+
   if (this->ranging_active_) {
     ESP_LOGD(TAG, " Update triggered while ranging active"); // should never happen
     return;
   }
 
-  if (!this->start_oneshot()) {
+  this->burst_frames_ = 0;
+  this->burst_valid_ = 0;
+  if (!this->start_ranging()) {
     ESP_LOGE(TAG, " Start ranging failed in update");
-    this->error_code_ = START_RANGING_FAILED;
-    this->mark_failed();
-    return;
+    this->start_recovery();
   }
-  this->ranging_active_ = true;
-  this->last_loop_time_ = millis();
 }
 
-float VL53L1XComponent::get_setup_priority() const { return setup_priority::DATA; }
+void VL53L1XComponent::request_distance_mode(DistanceMode distance_mode) {
+  if (this->is_vl53l4cd() && (distance_mode == LONG)) {
+    ESP_LOGW(TAG, "VL53L4CD Distance Mode must be SHORT, ignoring request");
+    return;
+  }
+  // the requested mode is kept rather than switched away from
+  if (this->auto_distance_mode_) {
+    ESP_LOGI(TAG, "Distance mode requested, automatic switching stopped");
+    this->auto_distance_mode_ = false;
+  }
+  this->queue_distance_mode(distance_mode);
+}
 
-bool VL53L1XComponent::boot_state(uint8_t* state) {
-  // 0 = not booted, 1 = booted
-  *state = 0;
-  return this->vl53l1x_read_byte(FIRMWARE__SYSTEM_STATUS, state);
+void VL53L1XComponent::queue_distance_mode(DistanceMode distance_mode) {
+  LockGuard guard(this->config_lock_);
+  this->pending_distance_mode_ = distance_mode;
+  this->pending_config_ |= PENDING_DISTANCE_MODE;
+  this->config_request_us_ = micros();
 }
 
-bool VL53L1XComponent::get_sensor_id(bool* valid_sensor) {
-  if (!this->vl53l1x_read_byte_16(IDENTIFICATION__MODEL_ID, &this->sensor_id_)) {
-    *valid_sensor = false;
-    return false;
+void VL53L1XComponent::request_timing_budget(uint16_t timing_budget_ms) {
+  uint16_t min_budget = (this->preset_ == PRESET_HIGH_RATE) ? TIMING_BUDGET_MIN_HIGH_RATE : TIMING_BUDGET_MIN;
+  uint16_t max_budget = (this->preset_ == PRESET_HIGH_RATE) ? TIMING_BUDGET_MAX_HIGH_RATE : TIMING_BUDGET_MAX;
+  if ((timing_budget_ms < min_budget) || (timing_budget_ms > max_budget)) {
+    ESP_LOGW(TAG, "Timing budget must be between %ums and %ums, ignoring request for %ums", min_budget, max_budget,
+             timing_budget_ms);
+    return;
   }
-  // 0xEACC = VL53L1X, 0xEBAA = VL53L4CD
-  *valid_sensor = ((this->sensor_id_ == 0xEACC) || (this->sensor_id_ == 0xEBAA));
-  return true;
+  // one-shot ranging (or the burst) must complete within the update interval
+  uint32_t frames = (this->burst_count_ != 0) ? this->burst_count_ + 1 : 2;
+  if (!this->free_running() && ((uint32_t)timing_budget_ms * frames > this->get_update_interval())) {
+    ESP_LOGW(TAG, "Timing budget %ums is too long for update interval %ums, ignoring request", timing_budget_ms,
+             this->get_update_interval());
+    return;
+  }
+  LockGuard guard(this->config_lock_);
+  this->pending_timing_budget_ = timing_budget_ms;
+  this->pending_config_ |= PENDING_TIMING_BUDGET;
+  this->config_request_us_ = micros();
 }
 
-bool VL53L1XComponent::set_distance_mode(DistanceMode distance_mode) {
-  uint16_t timing_budget;
-  if (!this->get_timing_budget(&timing_budget)) {
-    ESP_LOGE(TAG, "  Reading timimg budget failed when setting distance mode");
-    return false;
+void VL53L1XComponent::request_roi(uint8_t width, uint8_t height, uint8_t center) {
+  if ((width < 4) || (width > 16) || (height < 4) || (height > 16)) {
+    ESP_LOGW(TAG, "ROI width and height must be between 4 and 16, ignoring request");
+    return;
   }
+  LockGuard guard(this->config_lock_);
+  this->pending_roi_width_ = width;
+  this->pending_roi_height_ = height;
+  this->pending_roi_center_ = center;
+  this->pending_config_ |= PENDING_ROI;
+  this->config_request_us_ = micros();
+}
 
-  bool ok = true;
-  switch (distance_mode) {
-    case SHORT:
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_A, 0x07);
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_B, 0x05);
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VALID_PHASE_HIGH, 0x38);
-      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__WOI_SD0, 0x0705);
-      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__INITIAL_PHASE_SD0, 0x0606);
-      break;
-    case LONG:
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_A, 0x0F);
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_B, 0x0D);
-      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VALID_PHASE_HIGH, 0xB8);
-      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__WOI_SD0, 0x0F0D);
-      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__INITIAL_PHASE_SD0, 0x0E0E);
-      break;
-    default:
-      // should never happen
-      ESP_LOGE(TAG,"  Attempt to set invalid distance mode"); // should never happen
-      return false;
+void VL53L1XComponent::request_thresholds(float sigma_mm, float signal_mcps) {
+  if ((sigma_mm < SIGMA_THRESHOLD_MIN) || (sigma_mm > SIGMA_THRESHOLD_MAX)) {
+    ESP_LOGW(TAG, "Sigma threshold must be between %.0fmm and %.0fmm, ignoring request", SIGMA_THRESHOLD_MIN,
+             SIGMA_THRESHOLD_MAX);
+    return;
   }
-
-  if (!ok ) {
-    ESP_LOGE(TAG, "  Writing set distance mode configuration values failed");
-    return false;
+  if ((signal_mcps < SIGNAL_THRESHOLD_MIN) || (signal_mcps > SIGNAL_THRESHOLD_MAX)) {
+    ESP_LOGW(TAG, "Signal threshold must be between %.2fMcps and %.0fMcps, ignoring request", SIGNAL_THRESHOLD_MIN,
+             SIGNAL_THRESHOLD_MAX);
+    return;
   }
+  LockGuard guard(this->config_lock_);
+  this->pending_sigma_threshold_ = sigma_to_register(sigma_mm);
+  this->pending_signal_threshold_ = signal_rate_to_register(signal_mcps);
+  this->pending_config_ |= PENDING_THRESHOLDS;
+  this->config_request_us_ = micros();
+}
 
-  if (!this->set_timing_budget(timing_budget)) {
-    ESP_LOGE(TAG, "  Re-writing timing budget failed when setting distance mode");
-    return false;
+void VL53L1XComponent::request_roi_calibration() {
+  if ((this->preset_ != PRESET_LOW_POWER) || this->people_counting_ || this->pipelined_) {
+    ESP_LOGW(TAG, "ROI alignment scan requires preset low_power without people counting or pipelining, ignoring request");
+    return;
   }
+  if (this->roi_scan_active_)
+    return;
+  this->roi_scan_requested_ = true;
+}
 
-  return true;
+// forget the saved ROI and return to the configured one
+void VL53L1XComponent::reset_roi_calibration() {
+  RoiCalibration none{0, 0, 0};
+  this->roi_pref_.save(&none);
+  if (!this->roi_calibrated_)
+    return;
+  this->roi_calibrated_ = false;
+  ESP_LOGI(TAG, "Saved ROI cleared, returning to ROI %ux%u center %u", this->configured_roi_.width,
+           this->configured_roi_.height, this->configured_roi_.center);
+  this->request_roi(this->configured_roi_.width, this->configured_roi_.height, this->configured_roi_.center);
 }
 
+uint32_t VL53L1XComponent::preference_hash(const char *name) const {
+  uint32_t hash = fnv1_hash(name);
+#ifndef VL53L1X_SIMULATION
+  // each sensor on the bus has its own saved ROI and warm start record
+  hash ^= this->address_;
+#endif
+  return hash;
+}
 
-// Set the width and height of the region of interest
+// candidate 0 is the ROI in use, then each size at each grid position
+RoiCalibration VL53L1XComponent::roi_scan_candidate(uint8_t index) const {
+  if (index == 0)
+    return {this->roi_width_, this->roi_height_, this->roi_center_};
+  index--;
+  uint8_t size = ROI_SCAN_SIZES[index / ROI_SCAN_GRID];
+  uint8_t position = index % ROI_SCAN_GRID;
+  uint8_t column = ROI_SCAN_COLUMN + ROI_SCAN_OFFSETS[position % sizeof(ROI_SCAN_OFFSETS)];
+  uint8_t row = ROI_SCAN_ROW + ROI_SCAN_OFFSETS[position / sizeof(ROI_SCAN_OFFSETS)];
+  return {size, size, roi_center_spad(column, row)};
+}
+
+// range every candidate ROI with a short timing budget, so the scan takes about
+// 20 seconds whatever the configured timing budget, the target must stay in view
+bool VL53L1XComponent::start_roi_scan() {
+  ESP_LOGI(TAG, "ROI alignment scan of %u candidates started", ROI_SCAN_CANDIDATES);
+  this->roi_scan_active_ = true;
+  this->roi_scan_index_ = 0;
+  this->roi_scan_best_score_ = 0;
+  this->roi_scan_best_ = this->roi_scan_candidate(0);
+  this->roi_scan_start_time_ = millis();
+  this->completion_us_ = ROI_SCAN_TIMING_BUDGET * 1000;
+  {
+    LockGuard guard(this->config_lock_);
+    this->invalidate_warm_start_record();
+  }
+  if (!this->set_timing_budget(ROI_SCAN_TIMING_BUDGET))
+    return false;
+  return this->start_roi_scan_candidate();
+}
+
+bool VL53L1XComponent::start_roi_scan_candidate() {
+  RoiCalibration roi = this->roi_scan_candidate(this->roi_scan_index_);
+  this->roi_scan_frames_ = 0;
+  this->roi_scan_valid_ = 0;
+  this->roi_scan_signal_ = 0;
+  this->roi_scan_sigma_ = 0;
+  return this->set_roi_size(roi.width, roi.height) && this->set_roi_center(roi.center) && this->start_ranging();
+}
+
+// score each candidate by the proportion of valid frames and their mean
+// signal rate over mean sigma, a candidate with fewer than half valid scores 0
+bool VL53L1XComponent::roi_scan_step() {
+  bool is_dataready;
+  if (!this->poll_dataready(&is_dataready))
+    return false;
+  if (!is_dataready)
+    return true;
+  if (!this->perform_sensor_read())
+    return false;
+
+  // the first frame of each candidate lets dynamic SPAD selection settle
+  if ((this->roi_scan_frames_++ != 0) &&
+      (map_range_status(this->results_.range_status, this->results_.stream_count) <= RANGE_VALID_MIN_RANGE_CLIPPED)) {
+    this->roi_scan_valid_++;
+    this->roi_scan_signal_ += this->results_.peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+    this->roi_scan_sigma_ += this->results_.sigma_sd0;
+  }
+  if (this->roi_scan_frames_ <= ROI_SCAN_FRAMES)
+    return this->start_ranging();
+
+  float score = 0;
+  if ((this->roi_scan_valid_ * 2) >= ROI_SCAN_FRAMES) {
+    score = static_cast<float>(this->roi_scan_valid_) / ROI_SCAN_FRAMES * this->roi_scan_signal_ /
+            std::max<uint32_t>(this->roi_scan_sigma_, 1);
+  }
+  RoiCalibration roi = this->roi_scan_candidate(this->roi_scan_index_);
+  ESP_LOGV(TAG, "ROI %ux%u center %u: %u of %u frames valid, score %.2f", roi.width, roi.height, roi.center,
+           this->roi_scan_valid_, ROI_SCAN_FRAMES, score);
+  if (score > this->roi_scan_best_score_ * ROI_SCAN_MARGIN) {
+    this->roi_scan_best_score_ = score;
+    this->roi_scan_best_ = roi;
+  }
+
+  if (++this->roi_scan_index_ < ROI_SCAN_CANDIDATES)
+    return this->start_roi_scan_candidate();
+  return this->finish_roi_scan();
+}
+
+// use and save the best ROI, then return to the configured timing budget
+// ranging continues at the next update
+bool VL53L1XComponent::finish_roi_scan() {
+  this->roi_scan_active_ = false;
+  this->ranging_active_ = false;
+  this->completion_us_ = this->timing_budget_ * 1000;
+
+  if (this->roi_scan_best_score_ == 0) {
+    ESP_LOGW(TAG, "ROI alignment scan found no valid frames in %ums, keeping ROI %ux%u center %u",
+             millis() - this->roi_scan_start_time_, this->roi_width_, this->roi_height_, this->roi_center_);
+  }
+  else {
+    this->roi_width_ = this->roi_scan_best_.width;
+    this->roi_height_ = this->roi_scan_best_.height;
+    this->roi_center_ = this->roi_scan_best_.center;
+    this->roi_calibrated_ = true;
+    if (!this->roi_pref_.save(&this->roi_scan_best_))
+      ESP_LOGW(TAG, "Saving ROI failed");
+    ESP_LOGI(TAG, "ROI alignment scan chose ROI %ux%u center %u (score %.2f) in %ums", this->roi_width_,
+             this->roi_height_, this->roi_center_, this->roi_scan_best_score_, millis() - this->roi_scan_start_time_);
+  }
+
+  if (!this->set_timing_budget(this->timing_budget_) || !this->set_roi_size(this->roi_width_, this->roi_height_) ||
+      !this->set_roi_center(this->roi_center_))
+    return false;
+  // the calibration is kept, and setup loads the saved ROI, so the sensor
+  // now holds the configuration a restart would write
+  if (this->warm_start_)
+    this->update_warm_start_record();
+  return true;
+}
+
+// restore the VHV and phasecal calibration overrides from loop(), so the next
+// frame recalibrates for the current temperature, costing one frame rather than a reset
+void VL53L1XComponent::request_recalibration(const char *reason) {
+  this->recalibration_count_++;
+  ESP_LOGI(TAG, "Recalibrating (%s), %u recalibrations since boot", reason, this->recalibration_count_);
+  this->last_calibration_time_ = millis();
+  // statistics before the recalibration are not a baseline for those after it
+  this->window_frames_ = 0;
+  this->window_valid_ = 0;
+  this->window_sigma_ = 0;
+  this->baseline_set_ = false;
+
+  LockGuard guard(this->config_lock_);
+  this->pending_config_ |= PENDING_RECALIBRATION;
+  this->config_request_us_ = micros();
+}
+
+// stop ranging, write only the registers for settings which have changed
+// and restart ranging for the configured mode
+// the new settings are kept so they are also used if the sensor is reset
+bool VL53L1XComponent::apply_pending_config() {
+  LockGuard guard(this->config_lock_);
+  uint32_t start_transactions = this->bus_transactions_;
+  uint8_t pending = this->pending_config_;
+  this->pending_config_ = 0;
+
+  if ((pending & PENDING_DISTANCE_MODE) && (this->pending_distance_mode_ == this->distance_mode_))
+    pending &= ~PENDING_DISTANCE_MODE;
+  if ((pending & PENDING_TIMING_BUDGET) && (this->pending_timing_budget_ == this->timing_budget_))
+    pending &= ~PENDING_TIMING_BUDGET;
+  if ((pending & PENDING_ROI) && (this->pending_roi_width_ == this->roi_width_) &&
+      (this->pending_roi_height_ == this->roi_height_) && (this->pending_roi_center_ == this->roi_center_))
+    pending &= ~PENDING_ROI;
+  if ((pending & PENDING_THRESHOLDS) && (this->pending_sigma_threshold_ == this->sigma_threshold_) &&
+      (this->pending_signal_threshold_ == this->signal_threshold_))
+    pending &= ~PENDING_THRESHOLDS;
+  if (pending == 0)
+    return true;
+  if (pending != PENDING_RECALIBRATION)
+    this->invalidate_warm_start_record();
+  // rebuilt by the first frame with the new settings, once it has recalibrated
+  this->warm_start_record_pending_ = this->warm_start_;
+
+  // abort ranging and restore the calibration overrides, as VHV and phasecal
+  // are recalibrated by the first frame with the new settings
+  if (!this->stop_continuous())
+    return false;
+  this->ranging_active_ = false;
+  uint32_t stopped_us = micros();
+
+  if (pending & PENDING_TIMING_BUDGET) {
+    this->timing_budget_ = this->pending_timing_budget_;
+    this->completion_us_ = this->timing_budget_ * 1000;
+  }
+
+  if (pending & PENDING_DISTANCE_MODE) {
+    // also rewrites the timing budget
+    this->distance_mode_ = this->pending_distance_mode_;
+    if (!this->set_distance_mode(this->distance_mode_))
+      return false;
+  }
+  else if (pending & PENDING_TIMING_BUDGET) {
+    if (!this->set_timing_budget(this->timing_budget_))
+      return false;
+  }
+
+  if (pending & PENDING_ROI) {
+    if ((this->pending_roi_width_ != this->roi_width_) || (this->pending_roi_height_ != this->roi_height_)) {
+      this->roi_width_ = this->pending_roi_width_;
+      this->roi_height_ = this->pending_roi_height_;
+      if (!this->set_roi_size(this->roi_width_, this->roi_height_))
+        return false;
+    }
+    // people counting sets the centre of each zone itself
+    this->roi_center_ = this->pending_roi_center_;
+    if (!this->people_counting_ && !this->set_roi_center(this->roi_center_))
+      return false;
+  }
+
+  if (pending & PENDING_THRESHOLDS) {
+    this->sigma_threshold_ = this->pending_sigma_threshold_;
+    this->signal_threshold_ = this->pending_signal_threshold_;
+    if (!this->set_thresholds(this->sigma_threshold_, this->signal_threshold_))
+      return false;
+  }
+
+  // one-shot ranging restarts at the next update
+  if (this->free_running() && !this->start_ranging())
+    return false;
+
+  // frames started from now see the target differently, so the tracker restarts
+  // with the first of them rather than rejecting the step as an outlier
+  if (this->tracking_ && (pending & (PENDING_DISTANCE_MODE | PENDING_ROI))) {
+    this->tracker_restart_us_ = stopped_us;
+    this->tracker_restart_ = true;
+  }
+
+  if (pending & PENDING_DISTANCE_MODE)
+    this->distance_mode_switch_us_ = micros() - this->config_request_us_;
+  if (pending == PENDING_RECALIBRATION) {
+    ESP_LOGD(TAG, "Calibration overrides restored in %uus, next frame recalibrates",
+             micros() - this->config_request_us_);
+    return true;
+  }
+  ESP_LOGI(TAG,
+           "Reconfigured in %uus with %u transactions: distance mode %s, timing budget %ums, ROI %ux%u center %u, "
+           "sigma threshold %.2fmm, signal threshold %.3fMcps",
+           micros() - this->config_request_us_, this->bus_transactions_ - start_transactions,
+           (this->distance_mode_ == SHORT) ? "SHORT" : "LONG", this->timing_budget_, this->roi_width_,
+           this->roi_height_, this->roi_center_, this->sigma_threshold_ / 4.0f, this->signal_threshold_ / 128.0f);
+  return true;
+}
+
+// communication with the sensor failed after retries, so recover in place
+// rather than marking the component failed
+void VL53L1XComponent::start_recovery() {
+  ESP_LOGW(TAG, "Communication with sensor failed, recovering");
+  // with the acquisition task the main loop sets the warning
+  if (!this->acquisition_task_) {
+    this->status_set_warning();
+    // the outage is not a sampling interval
+    this->last_sample_ready_us_ = 0;
+  }
+  this->recovering_ = true;
+  this->ranging_active_ = false;
+  if (!this->free_running())
+    this->high_freq_.stop();
+  this->burst_frames_ = 0;
+  this->burst_valid_ = 0;
+  // frames are lost during the outage, so the path of a crossing in progress is broken
+  if (this->people_counting_)
+    this->people_counter_.reset();
+  this->recovery_attempts_ = 0;
+  this->recovery_start_time_ = millis();
+  // a scan in progress leaves a candidate ROI and its timing budget in the sensor
+  if (this->roi_scan_active_) {
+    this->roi_scan_active_ = false;
+    this->reset_on_recovery_ = true;
+    ESP_LOGW(TAG, "ROI alignment scan abandoned");
+  }
+  this->recover();
+}
+
+// first attempt clears the interrupt and restarts ranging, later attempts
+// soft reset the sensor and reconfigure it from the cached configuration
+// failed attempts are retried from loop() with bounded exponential backoff
+void VL53L1XComponent::recover() {
+  this->recovery_attempts_++;
+
+  bool reset = (this->recovery_attempts_ > 1) || this->reset_on_recovery_;
+  bool ok;
+  if (reset) {
+    ok = this->init_sensor() && this->start_ranging();
+  }
+  else {
+    ok = this->start_ranging();
+  }
+
+  if (!ok) {
+    uint8_t shift = (this->recovery_attempts_ < 8) ? (this->recovery_attempts_ - 1) : 7;
+    uint32_t backoff = RECOVERY_BACKOFF_MIN << shift;
+    if (backoff > RECOVERY_BACKOFF_MAX) backoff = RECOVERY_BACKOFF_MAX;
+    this->next_recovery_time_ = millis() + backoff;
+    ESP_LOGW(TAG, "Recovery attempt %u failed, retrying in %ums", this->recovery_attempts_, backoff);
+    return;
+  }
+
+  this->recovery_count_++;
+  this->reset_on_recovery_ = false;
+  // clear any error left by a failed attempt so dump_config() reports the sensor again
+  this->error_code_ = NONE;
+  ESP_LOGW(TAG, "Recovered by %s in %ums after %u attempts (%u recoveries since boot)",
+           reset ? "sensor reset" : "restarting ranging", millis() - this->recovery_start_time_,
+           this->recovery_attempts_, this->recovery_count_);
+  this->recovering_ = false;
+  if (!this->acquisition_task_)
+    this->status_clear_warning();
+}
+
+// read each frame of continuous ranging as it completes
+// returns false only on communication failure
+bool VL53L1XComponent::read_continuous() {
+  bool is_dataready;
+  if (!this->poll_dataready(&is_dataready))
+    return false;
+  if (!is_dataready)
+    return true;
+
+  // the next frame is timed from when this one was found complete
+  uint32_t start_us = this->frame_start_us_;
+  this->frame_start_us_ = micros();
+  if (!this->perform_sensor_read())
+    return false;
+
+  this->sample_queue_.push(this->make_sample(start_us));
+  return true;
+}
+
+// process queued samples, at most a batch per loop so a backlog queued by the
+// acquisition task while the main loop was held up does not hold up other components
+void VL53L1XComponent::drain_samples() {
+  Sample sample;
+  for (uint8_t i = 0; i < SAMPLE_BATCH; i++) {
+    if (!this->sample_queue_.pop(&sample))
+      break;
+    this->process_sample(sample);
+  }
+}
+
+#ifdef VL53L1X_ACQUISITION_TASK
+// the acquisition task runs continuous ranging, recovery and reconfiguration
+// off the main loop and hands samples to the main loop through the sample queue
+// with a dedicated bus frames are read on time whatever the main loop is doing,
+// with a shared bus the task only uses it while loop() lends it, so a stalled
+// main loop still delays reading, the queue then only absorbs the processing
+bool VL53L1XComponent::start_acquisition_task() {
+#ifdef USE_ESP32
+  this->bus_released_ = xSemaphoreCreateBinary();
+  this->task_done_ = xSemaphoreCreateBinary();
+  if ((this->bus_released_ == nullptr) || (this->task_done_ == nullptr))
+    return false;
+  return xTaskCreate(VL53L1XComponent::acquisition_task, "vl53l1x", ACQUISITION_TASK_STACK_SIZE, this,
+                     ACQUISITION_TASK_PRIORITY, &this->task_handle_) == pdPASS;
+#else
+  this->task_thread_ = std::thread(VL53L1XComponent::acquisition_task, this);
+  return true;
+#endif
+}
+
+// the task stops after the step in progress, or at once if waiting for a shared bus
+// or for the next step, returns once it has stopped so the sensor is left idle on the bus
+void VL53L1XComponent::stop_acquisition_task() {
+  if (this->task_stop_.exchange(true))
+    return;
+#ifdef USE_ESP32
+  if (this->task_handle_ == nullptr)
+    return;
+  xTaskNotifyGive(this->task_handle_);
+  if (xSemaphoreTake(this->task_done_, pdMS_TO_TICKS(TASK_STOP_TIMEOUT)) != pdTRUE)
+    ESP_LOGW(TAG, "Acquisition task did not stop within %ums", TASK_STOP_TIMEOUT);
+#else
+  if (this->task_thread_.joinable())
+    this->task_thread_.join();
+#endif
+}
+
+void VL53L1XComponent::on_shutdown() { this->stop_acquisition_task(); }
+
+VL53L1XComponent::~VL53L1XComponent() { this->stop_acquisition_task(); }
+
+void VL53L1XComponent::acquisition_task(void *param) {
+  auto *component = static_cast<VL53L1XComponent *>(param);
+  while (!component->task_stop_) {
+    uint32_t wait_us = std::max(component->acquisition_step(), DATAREADY_POLL_INTERVAL);
+#ifdef USE_ESP32
+    // woken early by a stop
+    ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(pdMS_TO_TICKS(wait_us / 1000), 1));
+#else
+    // a recovery backoff is slept in steps so a stop is not held up
+    std::this_thread::sleep_for(std::chrono::microseconds(std::min(wait_us, TASK_STOP_POLL_INTERVAL)));
+#endif
+  }
+#ifdef USE_ESP32
+  xSemaphoreGive(component->task_done_);
+  // the handle stays valid for a late notification, the node is shutting down
+  vTaskSuspend(nullptr);
+#endif
+}
+
+// perform any bus work which is due, returns the time in us until more is due
+uint32_t VL53L1XComponent::acquisition_step() {
+  uint32_t wait_us = this->acquisition_wait_us();
+  if (wait_us != 0)
+    return wait_us;
+
+  if (!this->acquire_bus())
+    return 0;
+  bool pending;
+  {
+    LockGuard guard(this->config_lock_);
+    pending = (this->pending_config_ != 0);
+  }
+  if (this->recovering_) {
+    this->recover();
+  }
+  else if (pending) {
+    if (!this->apply_pending_config())
+      this->start_recovery();
+  }
+  else if (!this->read_continuous()) {
+    this->start_recovery();
+  }
+  this->release_bus();
+
+  return this->acquisition_wait_us();
+}
+
+uint32_t VL53L1XComponent::acquisition_wait_us() {
+  if (this->recovering_) {
+    int32_t wait_ms = this->next_recovery_time_ - millis();
+    return (wait_ms > 0) ? wait_ms * 1000 : 0;
+  }
+  {
+    LockGuard guard(this->config_lock_);
+    if (this->pending_config_ != 0)
+      return 0;
+  }
+  return this->dataready_poll_wait(micros());
+}
+
+// with other devices on the bus, the task only uses it while the main loop
+// waits in lend_bus(), so their transactions are never interleaved
+// returns false if the task is stopping
+bool VL53L1XComponent::acquire_bus() {
+  if (!this->shared_bus_)
+    return true;
+  this->bus_request_ = true;
+  while (!this->bus_granted_) {
+    if (this->task_stop_) {
+      // a main loop granting the bus meanwhile is not left waiting
+      this->release_bus();
+      return false;
+    }
+#ifdef USE_ESP32
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds(BUS_REQUEST_POLL_INTERVAL));
+#endif
+  }
+  this->bus_held_ = true;
+  return true;
+}
+
+// the request is withdrawn first, so a main loop still lending returns at once
+void VL53L1XComponent::release_bus() {
+  if (!this->shared_bus_)
+    return;
+  this->bus_held_ = false;
+  this->bus_request_ = false;
+  this->bus_granted_ = false;
+#ifdef USE_ESP32
+  xSemaphoreGive(this->bus_released_);
+#endif
+}
+
+// called from loop(), blocks while the task uses the bus rather than spinning,
+// the task gives it back between the register groups of a sensor reset
+void VL53L1XComponent::lend_bus() {
+  if (!this->shared_bus_ || !this->bus_request_)
+    return;
+  this->bus_granted_ = true;
+#ifdef USE_ESP32
+  xTaskNotifyGive(this->task_handle_);
+#endif
+  while (this->bus_request_ && this->bus_granted_) {
+#ifdef USE_ESP32
+    xSemaphoreTake(this->bus_released_, portMAX_DELAY);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds(BUS_REQUEST_POLL_INTERVAL));
+#endif
+  }
+}
+#endif
+
+// during a long wait, a shared bus held by the acquisition task is given back
+// until the main loop has run once more, returns false if the task is stopping
+bool VL53L1XComponent::yield_bus() {
+#ifdef VL53L1X_ACQUISITION_TASK
+  if (!this->bus_held_)
+    return true;
+  this->release_bus();
+  return this->acquire_bus();
+#else
+  return true;
+#endif
+}
+
+// read each zone of people counting as it completes, then start ranging
+// the other zone straight away
+// returns false only on communication failure
+bool VL53L1XComponent::read_people_counter() {
+  bool is_dataready;
+  if (!this->poll_dataready(&is_dataready))
+    return false;
+  if (!is_dataready)
+    return true;
+
+  uint32_t start_us = micros();
+  uint32_t frame_start_us = this->frame_start_us_;
+  if (!this->perform_sensor_read())
+    return false;
+
+  // perform_sensor_read() has cleared the interrupt, so only the
+  // ROI centre and the start of the next one-shot are needed
+  uint8_t zone = this->zone_;
+  this->zone_ = (zone + 1) % PEOPLE_COUNTER_ZONES;
+  if (!this->set_roi_center(this->zone_centre_[this->zone_]))
+    return false;
+  if (!this->start_next_oneshot())
+    return false;
+
+  Sample sample = this->make_sample(frame_start_us);
+  bool occupied = (sample.range_status <= RANGE_VALID_MIN_RANGE_CLIPPED) && (sample.distance_mm < this->people_threshold_);
+  PeopleCounter::Event event = this->people_counter_.process(zone, occupied);
+  if (event != PeopleCounter::NO_EVENT) {
+    ESP_LOGD(TAG, "People counter: %s, occupancy %u", (event == PeopleCounter::ENTRY) ? "entry" : "exit",
+             this->people_counter_.get_occupancy());
+    this->publish_people_counts();
+  }
+
+  this->process_sample(sample);
+
+  uint32_t process_us = micros() - start_us;
+  if (process_us > this->zone_process_us_max_)
+    this->zone_process_us_max_ = process_us;
+  return true;
+}
+
+// read each one-shot as it completes and start the next one straight away,
+// so the sample is processed and published while the sensor is ranging
+// returns false only on communication failure
+bool VL53L1XComponent::read_pipelined() {
+  bool is_dataready;
+  if (!this->poll_dataready(&is_dataready))
+    return false;
+  if (!is_dataready)
+    return true;
+
+  // DSS and the interrupt clear must be written before the next frame starts,
+  // everything after that overlaps with ranging
+  if (!this->perform_sensor_read())
+    return false;
+  Sample sample = this->make_sample(this->frame_start_us_);
+  if (!this->start_next_oneshot())
+    return false;
+
+  this->process_sample(sample);
+  return true;
+}
+
+void VL53L1XComponent::publish_people_counts() {
+  if (this->entry_count_sensor_ != nullptr)
+    this->entry_count_sensor_->publish_state(this->people_counter_.get_entries());
+  if (this->exit_count_sensor_ != nullptr)
+    this->exit_count_sensor_->publish_state(this->people_counter_.get_exits());
+  if (this->occupancy_sensor_ != nullptr)
+    this->occupancy_sensor_->publish_state(this->people_counter_.get_occupancy());
+}
+
+// per sample processing, called for every frame read in every mode
+// record of the frame just read, which was started at start_us
+Sample VL53L1XComponent::make_sample(uint32_t start_us) const {
+  Sample sample;
+  sample.start_us = start_us;
+  sample.ready_us = this->frame_ready_us_;
+  sample.distance_mm = apply_range_gain(this->results_.final_crosstalk_corrected_range_mm_sd0);
+  sample.sigma = this->results_.sigma_sd0;
+  sample.ambient_rate = this->results_.ambient_count_rate_mcps_sd0;
+  sample.range_status = map_range_status(this->results_.range_status, this->results_.stream_count);
+  return sample;
+}
+
+void VL53L1XComponent::process_sample(const Sample &sample) {
+  this->distance_ = sample.distance_mm;
+  this->range_status_ = static_cast<RangeStatus>(sample.range_status);
+  this->sample_start_us_ = sample.start_us;
+  this->sample_ready_us_ = sample.ready_us;
+  this->sample_count_++;
+  this->status_counts_[std::min<uint8_t>(sample.range_status, UNDEFINED)]++;
+  this->new_sample_ = true;
+  this->update_sample_interval();
+
+#ifdef VL53L1X_SAMPLE_EXPORT
+  if (this->export_uart_ != nullptr)
+    this->export_sample(sample);
+#endif
+
+  if (this->tracking_) {
+    uint32_t start_us = micros();
+    this->update_tracker(sample);
+    uint32_t process_us = micros() - start_us;
+    if (process_us > this->tracker_us_max_)
+      this->tracker_us_max_ = process_us;
+  }
+
+  if (this->presence_detection_)
+    this->update_presence();
+
+  if (this->recalibration_)
+    this->update_recalibration(sample);
+
+  if (this->auto_distance_mode_)
+    this->update_distance_mode(sample);
+}
+
+void VL53L1XComponent::update_distance_mode(const Sample &sample) {
+  uint32_t now = millis();
+  if (!this->distance_mode_selector_.process(now, static_cast<RangeStatus>(sample.range_status), sample.distance_mm,
+                                             sample.ambient_rate))
+    return;
+
+  DistanceMode distance_mode = this->distance_mode_selector_.is_long() ? SHORT : LONG;
+  ESP_LOGD(TAG, "Switching distance mode to %s, ambient %.2fMcps", (distance_mode == SHORT) ? "SHORT" : "LONG",
+           this->distance_mode_selector_.get_ambient_mcps());
+  this->distance_mode_switches_++;
+  this->distance_mode_selector_.reset(now, distance_mode == LONG);
+  this->queue_distance_mode(distance_mode);
+}
+
+// compare the proportion of valid frames and their mean sigma over each window
+// with the first window after calibration, and recalibrate if either has degraded
+void VL53L1XComponent::update_recalibration(const Sample &sample) {
+  this->window_frames_++;
+  if (sample.range_status <= RANGE_VALID_MIN_RANGE_CLIPPED) {
+    this->window_valid_++;
+    this->window_sigma_ += sample.sigma;
+  }
+  if (this->window_frames_ < RECALIBRATION_WINDOW)
+    return;
+
+  float valid = static_cast<float>(this->window_valid_) / this->window_frames_;
+  // sigma is mm in 14.2 format
+  float sigma_mm = (this->window_valid_ != 0) ? this->window_sigma_ * 0.25f / this->window_valid_ : NAN;
+  this->window_frames_ = 0;
+  this->window_valid_ = 0;
+  this->window_sigma_ = 0;
+
+  if (!this->baseline_set_) {
+    // without a valid frame there is no sigma to compare against
+    if (std::isnan(sigma_mm))
+      return;
+    this->baseline_valid_ = valid;
+    this->baseline_sigma_mm_ = sigma_mm;
+    this->baseline_set_ = true;
+    ESP_LOGV(TAG, "Recalibration baseline: %.0f%% valid, mean sigma %.1fmm", valid * 100.0f, sigma_mm);
+    return;
+  }
+
+  const char *reason = nullptr;
+  if ((this->recalibration_sigma_increase_ > 0) && !std::isnan(sigma_mm) &&
+      (sigma_mm > this->baseline_sigma_mm_ * (1.0f + this->recalibration_sigma_increase_)))
+    reason = "sigma increased";
+  else if ((this->recalibration_valid_drop_ > 0) &&
+           (valid < this->baseline_valid_ * (1.0f - this->recalibration_valid_drop_)))
+    reason = "valid frames dropped";
+  if (reason == nullptr)
+    return;
+
+  ESP_LOGD(TAG, "Frame statistics degraded: %.0f%% valid, mean sigma %.1fmm (baseline %.0f%%, %.1fmm)",
+           valid * 100.0f, sigma_mm, this->baseline_valid_ * 100.0f, this->baseline_sigma_mm_);
+  if ((millis() - this->last_calibration_time_) >= RECALIBRATION_HOLDOFF)
+    this->request_recalibration(reason);
+}
+
+#ifdef VL53L1X_SAMPLE_EXPORT
+// a fixed size binary record needs no formatting, so every frame can be
+// exported at the highest sample rate, unlike logging
+void VL53L1XComponent::export_sample(const Sample &sample) {
+  uint8_t record[SAMPLE_RECORD_SIZE];
+  encode_sample_record(sample, this->export_sequence_++, record);
+  this->export_uart_->write_array(record, SAMPLE_RECORD_SIZE);
+}
+#endif
+
+// presence events are raised from the frame which completes the debounce time
+void VL53L1XComponent::update_presence() {
+  bool target_detected;
+  switch (this->range_status_) {
+    case RANGE_VALID:
+    case RANGE_VALID_NOWRAP_CHECK_FAIL:
+    case RANGE_VALID_MIN_RANGE_CLIPPED:
+      target_detected = true;
+      break;
+    case SIGNAL_FAIL:
+    case OUT_OF_BOUNDS_FAIL:
+      // nothing in range
+      target_detected = false;
+      break;
+    default:
+      // frame gives no information about presence
+      return;
+  }
+
+  PresenceDetector::Event event = this->presence_detector_.process(millis(), target_detected, this->distance_);
+  if (event == PresenceDetector::NO_EVENT)
+    return;
+
+  ESP_LOGD(TAG, "Presence %s at %umm",
+           (event == PresenceDetector::ENTER) ? "enter" : (event == PresenceDetector::LEAVE) ? "leave" : "dwell",
+           this->distance_);
+#ifdef USE_BINARY_SENSOR
+  if ((this->presence_binary_sensor_ != nullptr) && (event != PresenceDetector::DWELL))
+    this->presence_binary_sensor_->publish_state(this->presence_detector_.is_present());
+#endif
+  this->presence_callback_.call(event);
+}
+
+// measurement noise is the sigma estimate of the frame (14.2 format mm),
+// increased for frames which are valid but flagged, frames which
+// are not valid are not used
+void VL53L1XComponent::update_tracker(const Sample &sample) {
+  if (this->tracker_restart_ && ((int32_t)(sample.start_us - this->tracker_restart_us_) >= 0)) {
+    this->tracker_restart_ = false;
+    this->tracker_.reset();
+  }
+  float sigma_mm = sample.sigma * 0.25f;
+  if (sigma_mm < TRACKER_MIN_SIGMA) sigma_mm = TRACKER_MIN_SIGMA;
+
+  switch (this->range_status_) {
+    case RANGE_VALID:
+      break;
+    case RANGE_VALID_NOWRAP_CHECK_FAIL:
+    case RANGE_VALID_MIN_RANGE_CLIPPED:
+      sigma_mm *= 2.0f;
+      break;
+    default:
+      return;
+  }
+
+  // rejections are counted rather than logged, as they may come at the frame rate
+  if (!this->tracker_.update(this->sample_ready_us_, this->distance_, sigma_mm))
+    this->tracker_rejections_++;
+}
+
+// add the latest sample to the burst, returns true once the burst is complete
+// and the combined distance and status have replaced those of the sample
+bool VL53L1XComponent::add_burst_sample() {
+  this->burst_frames_++;
+  if (this->range_status_ <= RANGE_VALID_MIN_RANGE_CLIPPED) {
+    if (this->burst_valid_ == 0)
+      this->burst_status_ = this->range_status_;
+    else if (this->range_status_ > this->burst_status_)
+      this->burst_status_ = this->range_status_;
+    this->burst_distances_[this->burst_valid_++] = this->distance_;
+  }
+  if (this->burst_frames_ < this->burst_count_)
+    return false;
+
+  // with fewer than half the frames valid, the last frame is published as it is
+  if ((this->burst_valid_ * 2) >= this->burst_frames_) {
+    sort_distances(this->burst_distances_, this->burst_valid_);
+    this->distance_ = (this->burst_average_ == BURST_MEDIAN)
+                          ? median_distance(this->burst_distances_, this->burst_valid_)
+                          : trimmed_mean_distance(this->burst_distances_, this->burst_valid_);
+    // the least certain valid status of the frames used
+    this->range_status_ = this->burst_status_;
+    this->burst_spread_ = this->burst_distances_[this->burst_valid_ - 1] - this->burst_distances_[0];
+  }
+  else {
+    this->burst_spread_ = NAN;
+  }
+  ESP_LOGV(TAG, "Burst of %u frames, %u valid, spread %.0fmm", this->burst_frames_, this->burst_valid_,
+           this->burst_spread_);
+  this->burst_frames_ = 0;
+  this->burst_valid_ = 0;
+  return true;
+}
+
+void VL53L1XComponent::publish_results() {
+  ESP_LOGD(TAG, "Publishing Distance: %imm with Ranging status: %i",this->distance_,this->range_status_);
+  if (this->distance_sensor_ != nullptr)
+     this->distance_sensor_->publish_state(this->distance_);
+  if (this->range_status_sensor_ != nullptr)
+     this->range_status_sensor_->publish_state(this->range_status_);
+  if (this->tracking_ && this->tracker_.is_initialised()) {
+    if (this->filtered_distance_sensor_ != nullptr)
+      this->filtered_distance_sensor_->publish_state(this->tracker_.get_distance());
+    if (this->velocity_sensor_ != nullptr)
+      this->velocity_sensor_->publish_state(this->tracker_.get_velocity());
+  }
+
+  if ((this->burst_count_ != 0) && (this->burst_spread_sensor_ != nullptr))
+    this->burst_spread_sensor_->publish_state(this->burst_spread_);
+
+  // latency is measured once the distance has been published
+  uint32_t now = micros();
+  if (this->start_latency_sensor_ != nullptr)
+    this->start_latency_sensor_->publish_state((now - this->sample_start_us_) / 1000.0f);
+  if (this->completion_latency_sensor_ != nullptr)
+    this->completion_latency_sensor_->publish_state((now - this->sample_ready_us_) / 1000.0f);
+  this->new_sample_ = false;
+}
+
+// accumulate the interval between completed samples
+void VL53L1XComponent::update_sample_interval() {
+  if (this->last_sample_ready_us_ != 0) {
+    float interval_us = this->sample_ready_us_ - this->last_sample_ready_us_;
+    this->interval_count_++;
+    float delta = interval_us - this->interval_mean_us_;
+    this->interval_mean_us_ += delta / this->interval_count_;
+    this->interval_m2_ += delta * (interval_us - this->interval_mean_us_);
+  }
+  this->last_sample_ready_us_ = this->sample_ready_us_;
+}
+
+// publish the mean sampling interval and its standard deviation (jitter)
+// since the previous update, then start accumulating again
+void VL53L1XComponent::publish_sample_interval() {
+  if (this->interval_count_ != 0) {
+    if (this->sample_interval_sensor_ != nullptr)
+      this->sample_interval_sensor_->publish_state(this->interval_mean_us_ / 1000.0f);
+    if (this->sample_jitter_sensor_ != nullptr)
+      this->sample_jitter_sensor_->publish_state(sqrtf(this->interval_m2_ / this->interval_count_) / 1000.0f);
+  }
+  this->interval_count_ = 0;
+  this->interval_mean_us_ = 0;
+  this->interval_m2_ = 0;
+}
+
+// log the frames of each range status since the previous update and publish
+// the rates of the ones decided by the sigma and signal thresholds
+void VL53L1XComponent::publish_status_counts(uint32_t elapsed_ms) {
+  const uint32_t *counts = this->status_counts_;
+  uint32_t valid = counts[RANGE_VALID] + counts[RANGE_VALID_NOWRAP_CHECK_FAIL] + counts[RANGE_VALID_MIN_RANGE_CLIPPED];
+  ESP_LOGD(TAG, "Range status since the previous update: %u valid, %u sigma fail, %u signal fail, %u other", valid,
+           counts[SIGMA_FAIL], counts[SIGNAL_FAIL],
+           counts[HARDWARE_FAIL] + counts[OUT_OF_BOUNDS_FAIL] + counts[WRAP_TARGET_FAIL] + counts[MIN_RANGE_FAIL] +
+               counts[UNDEFINED]);
+  if (elapsed_ms != 0) {
+    float scale = 1000.0f / elapsed_ms;
+    if (this->valid_rate_sensor_ != nullptr)
+      this->valid_rate_sensor_->publish_state(valid * scale);
+    if (this->sigma_fail_rate_sensor_ != nullptr)
+      this->sigma_fail_rate_sensor_->publish_state(counts[SIGMA_FAIL] * scale);
+    if (this->signal_fail_rate_sensor_ != nullptr)
+      this->signal_fail_rate_sensor_->publish_state(counts[SIGNAL_FAIL] * scale);
+  }
+  for (uint32_t &count : this->status_counts_)
+    count = 0;
+}
+
+float VL53L1XComponent::get_setup_priority() const { return setup_priority::DATA; }
+
+bool VL53L1XComponent::boot_state(uint8_t* state) {
+  // 0 = not booted, 1 = booted
+  *state = 0;
+  return this->vl53l1x_read_byte(FIRMWARE__SYSTEM_STATUS, state);
+}
+
+bool VL53L1XComponent::get_sensor_id(bool* valid_sensor) {
+  if (!this->vl53l1x_read_byte_16(IDENTIFICATION__MODEL_ID, &this->sensor_id_)) {
+    *valid_sensor = false;
+    return false;
+  }
+#if defined(VL53L1X_VARIANT_VL53L4CD)
+  *valid_sensor = (this->sensor_id_ == VL53L4CD_MODEL_ID);
+#elif defined(VL53L1X_VARIANT_VL53L1X)
+  *valid_sensor = (this->sensor_id_ == VL53L1X_MODEL_ID);
+#else
+  *valid_sensor = ((this->sensor_id_ == VL53L1X_MODEL_ID) || (this->sensor_id_ == VL53L4CD_MODEL_ID));
+#endif
+  return true;
+}
+
+// the timing budget registers depend on the VCSEL periods, so they are
+// rewritten here for the configured timing budget
+bool VL53L1XComponent::set_distance_mode(DistanceMode distance_mode) {
+  bool ok = true;
+  switch (distance_mode) {
+    case SHORT:
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_A, 0x07);
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_B, 0x05);
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VALID_PHASE_HIGH, 0x38);
+      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__WOI_SD0, 0x0705);
+      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__INITIAL_PHASE_SD0, 0x0606);
+      break;
+#ifndef VL53L1X_VARIANT_VL53L4CD
+    case LONG:
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_A, 0x0F);
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VCSEL_PERIOD_B, 0x0D);
+      if (ok) ok = this->vl53l1x_write_byte(RANGE_CONFIG__VALID_PHASE_HIGH, 0xB8);
+      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__WOI_SD0, 0x0F0D);
+      if (ok) ok = this->vl53l1x_write_byte_16(SD_CONFIG__INITIAL_PHASE_SD0, 0x0E0E);
+      break;
+#endif
+    default:
+      // should never happen
+      ESP_LOGE(TAG,"  Attempt to set invalid distance mode"); // should never happen
+      return false;
+  }
+
+  if (!ok ) {
+    ESP_LOGE(TAG, "  Writing set distance mode configuration values failed");
+    return false;
+  }
+
+  if (!this->set_timing_budget(this->timing_budget_)) {
+    ESP_LOGE(TAG, "  Re-writing timing budget failed when setting distance mode");
+    return false;
+  }
+
+  return true;
+}
+
+
+// Set the width and height of the region of interest
 // based on VL53L1X_SetROI() from STSW-IMG009 Ultra Lite Driver
 //
 // ST user manual UM2555 explains ROI selection in detail, so we recommend
@@ -1622,6 +3115,49 @@ bool VL53L1XComponent::set_roi_size(uint8_t width, uint8_t height)
   return ok;
 }
 
+// set the center SPAD of the region of interest (ROI)
+// based on VL53L1X_SetROICenter() from STSW-IMG009 Ultra Lite Driver
+//
+// ST user manual UM2555 explains ROI selection in detail, so we recommend
+// reading that document carefully. Here is a table of SPAD locations from
+// UM2555 (199 is the default/center):
+//
+// 128,136,144,152,160,168,176,184,  192,200,208,216,224,232,240,248
+// 129,137,145,153,161,169,177,185,  193,201,209,217,225,233,241,249
+// 130,138,146,154,162,170,178,186,  194,202,210,218,226,234,242,250
+// 131,139,147,155,163,171,179,187,  195,203,211,219,227,235,243,251
+// 132,140,148,156,164,172,180,188,  196,204,212,220,228,236,244,252
+// 133,141,149,157,165,173,181,189,  197,205,213,221,229,237,245,253
+// 134,142,150,158,166,174,182,190,  198,206,214,222,230,238,246,254
+// 135,143,151,159,167,175,183,191,  199,207,215,223,231,239,247,255
+//
+// 127,119,111,103, 95, 87, 79, 71,   63, 55, 47, 39, 31, 23, 15,  7
+// 126,118,110,102, 94, 86, 78, 70,   62, 54, 46, 38, 30, 22, 14,  6
+// 125,117,109,101, 93, 85, 77, 69,   61, 53, 45, 37, 29, 21, 13,  5
+// 124,116,108,100, 92, 84, 76, 68,   60, 52, 44, 36, 28, 20, 12,  4
+// 123,115,107, 99, 91, 83, 75, 67,   59, 51, 43, 35, 27, 19, 11,  3
+// 122,114,106, 98, 90, 82, 74, 66,   58, 50, 42, 34, 26, 18, 10,  2
+// 121,113,105, 97, 89, 81, 73, 65,   57, 49, 41, 33, 25, 17,  9,  1
+// 120,112,104, 96, 88, 80, 72, 64,   56, 48, 40, 32, 24, 16,  8,  0 <- Pin 1
+//
+// This table is oriented as if looking into the front of the sensor (or top of
+// the chip). SPAD 0 is closest to pin 1 of the VL53L1X, which is the corner
+// closest to the VDD pin on the Pololu VL53L1X carrier board
+//
+// this function was adapted from the original VL53L1X::setROICenter() function
+// in the VL53L1X library for Arduino (https://www.pololu.com/)
+bool VL53L1XComponent::set_roi_center(uint8_t spad_number) {
+  return this->vl53l1x_write_byte(ROI_CONFIG__USER_ROI_CENTRE_SPAD, spad_number);
+}
+
+// frames with a larger sigma estimate are SIGMA_FAIL, frames with a lower
+// return signal rate are SIGNAL_FAIL
+bool VL53L1XComponent::set_thresholds(uint16_t sigma_threshold, uint16_t signal_threshold) {
+  bool ok = this->vl53l1x_write_byte_16(RANGE_CONFIG__SIGMA_THRESH, sigma_threshold);
+  if (ok) ok = this->vl53l1x_write_byte_16(RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS, signal_threshold);
+  return ok;
+}
+
 // set the measurement timing budget, which is the time allowed for one measurement
 // longer timing budget allows for more accurate measurements
 // based on VL53L1_SetMeasurementTimingBudgetMicroSeconds()
@@ -1629,13 +3165,14 @@ bool VL53L1XComponent::set_timing_budget(uint16_t timing_budget_ms) {
   uint32_t budget_us;
   budget_us = (uint32_t)(timing_budget_ms * 1000);
 
-  // assumes PresetMode is LOWPOWER_AUTONOMOUS
-  if (budget_us <= TIMING_GUARD) return false;
+  uint32_t timing_guard = this->timing_guard_us();
+  if (budget_us <= timing_guard) return false;
 
-  uint32_t range_config_timeout_us = budget_us -= TIMING_GUARD;
+  uint32_t range_config_timeout_us = budget_us -= timing_guard;
   if (range_config_timeout_us > 1100000) return false; // FDA_MAX_TIMING_BUDGET_US * 2
 
-  range_config_timeout_us /= 2;
+  // low power auto splits the budget between range timing A and B
+  if (this->preset_ == PRESET_LOW_POWER) range_config_timeout_us /= 2;
 
   // based on VL53L1_calc_timeout_register_values()
 
@@ -1644,7 +3181,7 @@ bool VL53L1XComponent::set_timing_budget(uint16_t timing_budget_ms) {
   // update macro period for Range A VCSEL Period
   uint8_t temp;
   if (!this->vl53l1x_read_byte(RANGE_CONFIG__VCSEL_PERIOD_A, &temp)) return false;
-  macro_period_us = calculate_macro_period(temp);
+  macro_period_us = calculate_macro_period(temp, this->fast_osc_frequency_);
 
   // update phase timeout - uses Timing A
   // timeout of 1000 is tuning parm default (TIMED_PHASECAL_CONFIG_TIMEOUT_US_DEFAULT)
@@ -1670,7 +3207,7 @@ bool VL53L1XComponent::set_timing_budget(uint16_t timing_budget_ms) {
 
   // update macro period for Range B VCSEL Period
   if (!this->vl53l1x_read_byte(RANGE_CONFIG__VCSEL_PERIOD_B, &temp)) return false;
-  macro_period_us = calculate_macro_period(temp);
+  macro_period_us = calculate_macro_period(temp, this->fast_osc_frequency_);
 
   // update MM Timing B timeout
   // see above comment about MM Timing A timeout
@@ -1680,21 +3217,22 @@ bool VL53L1XComponent::set_timing_budget(uint16_t timing_budget_ms) {
   // update Range Timing B timeout
   if (!this->vl53l1x_write_byte_16(RANGE_CONFIG__TIMEOUT_MACROP_B,
                                    encode_timeout(timeout_microseconds_to_mclks(range_config_timeout_us, macro_period_us)))) return false;
+  this->frame_budget_ms_ = timing_budget_ms;
   return true;
 }
 
 // get the measurement timing budget in microseconds
 // based on VL53L1_SetMeasurementTimingBudgetMicroSeconds()
 bool VL53L1XComponent::get_timing_budget(uint16_t *timing_budget_ms) {
-  // assumes PresetMode is LOWPOWER_AUTONOMOUS and these sequence steps are
-  // enabled: VHV, PHASECAL, DSS1, RANGE
+  // assumes PresetMode is LOWPOWER_AUTONOMOUS (or VL53L4CD back-to-back for high rate)
+  // and these sequence steps are enabled: VHV, PHASECAL, DSS1, RANGE
 
   // VL53L1_get_timeouts_us() begin
 
   // update macro period for Range A VCSEL Period
   uint8_t temp_macro;
   if (!this->vl53l1x_read_byte(RANGE_CONFIG__VCSEL_PERIOD_A, &temp_macro)) return false;
-  uint32_t macro_period_us = calculate_macro_period(temp_macro);
+  uint32_t macro_period_us = calculate_macro_period(temp_macro, this->fast_osc_frequency_);
 
   // get Range Timing A timeout
   uint16_t temp_timeout;
@@ -1703,7 +3241,9 @@ bool VL53L1XComponent::get_timing_budget(uint16_t *timing_budget_ms) {
 
   // VL53L1_get_timeouts_us() end
 
-  uint32_t timing_budget_us = (2 * range_config_timeout_us) + TIMING_GUARD;
+  uint32_t timing_budget_us = range_config_timeout_us;
+  if (this->preset_ == PRESET_LOW_POWER) timing_budget_us *= 2;
+  timing_budget_us += this->timing_guard_us();
   *timing_budget_ms = (uint16_t)(timing_budget_us / 1000);
   return true;
 }
@@ -1731,8 +3271,13 @@ bool VL53L1XComponent::get_distance_mode(DistanceMode *mode) {
   return false;
 }
 
+uint32_t VL53L1XComponent::timing_guard_us() const {
+  return (this->preset_ == PRESET_HIGH_RATE) ? TIMING_GUARD_HIGH_RATE : TIMING_GUARD;
+}
+
 // start continuous ranging measurements, with the given intermeasurement
 // period in milliseconds determining how often the sensor takes a measurement
+// a period of 0 starts VL53L4CD back-to-back ranging (as VL53L4CD_StartRanging())
 // based on VL53L1_set_inter_measurement_period_ms()
 bool VL53L1XComponent::start_continuous(uint32_t period_ms) {
   uint32_t intermeasurement_period = static_cast<uint32_t>(period_ms * this->osc_calibrate_val_);
@@ -1749,8 +3294,8 @@ bool VL53L1XComponent::start_continuous(uint32_t period_ms) {
     return false;
   }
 
-  // mode_range__timed
-  if (!this->vl53l1x_write_byte(SYSTEM__MODE_START, 0x40)) {
+  // mode_range__timed, or mode_range__back_to_back
+  if (!this->vl53l1x_write_byte(SYSTEM__MODE_START, (period_ms == 0) ? 0x21 : 0x40)) {
     ESP_LOGE(TAG, "Error writing start continuous ranging");
     return false;
   }
@@ -1808,6 +3353,73 @@ bool VL53L1XComponent::start_oneshot() {
 }
 
 
+// start the next of back to back one-shots, perform_sensor_read() has
+// already cleared the interrupt of the frame just read
+bool VL53L1XComponent::start_next_oneshot() {
+  if (!this->vl53l1x_write_byte(SYSTEM__MODE_START, 0x10)) {
+    ESP_LOGE(TAG, "  Error writing start one-shot ranging");
+    return false;
+  }
+  this->frame_start_us_ = micros();
+  this->dataready_polls_ = 0;
+  return true;
+}
+
+// time in us until data ready should next be checked, 0 if now
+uint32_t VL53L1XComponent::dataready_poll_wait(uint32_t now) const {
+  uint32_t elapsed = now - this->frame_start_us_;
+  uint32_t completion_us = this->completion_us_;
+  if ((elapsed + DATAREADY_POLL_INTERVAL) < completion_us)
+    return completion_us - DATAREADY_POLL_INTERVAL - elapsed;
+  uint32_t since_poll = now - this->last_poll_us_;
+  if ((this->dataready_polls_ != 0) && (since_poll < DATAREADY_POLL_INTERVAL))
+    return DATAREADY_POLL_INTERVAL - since_poll;
+  return 0;
+}
+
+// check data ready once the frame in progress is expected to have completed,
+// then at DATAREADY_POLL_INTERVAL until it has, so a frame is read as soon as
+// it completes and a late frame is not lost
+// the expected completion time starts at the timing budget and is learned
+// from the frames of this sensor, first check is one poll interval before it
+// returns false on communication failure or if the frame never completes
+bool VL53L1XComponent::poll_dataready(bool *is_dataready) {
+  *is_dataready = false;
+
+  uint32_t now = micros();
+  if (this->dataready_poll_wait(now) != 0)
+    return true;
+
+  // poll without waiting for the next main loop interval
+  if (!this->acquisition_task_)
+    this->high_freq_.start();
+  this->last_poll_us_ = now;
+  this->dataready_polls_++;
+
+  if (!this->check_for_dataready(is_dataready))
+    return false;
+
+  uint32_t elapsed = now - this->frame_start_us_;
+  if (!*is_dataready) {
+    // the budget programmed for this frame, which differs from timing_budget_ during a roi scan
+    if (elapsed > (this->frame_budget_ms_ * 2000 + DATAREADY_TIMEOUT_MARGIN)) {
+      ESP_LOGW(TAG, "  Data ready timed out after %ums", elapsed / 1000);
+      return false;
+    }
+    return true;
+  }
+
+  this->frame_ready_us_ = now;
+
+  // moving average over 8 frames
+  uint32_t completion_us = this->completion_us_;
+  this->completion_us_ = completion_us - (completion_us >> 3) + (elapsed >> 3);
+  this->dataready_polls_ = 0;
+  if (!this->free_running())
+    this->high_freq_.stop();
+  return true;
+}
+
 bool VL53L1XComponent::check_for_dataready(bool *is_dataready) {
   uint8_t temp;
   if (!this->vl53l1x_read_byte(GPIO__TIO_HV_STATUS, &temp)) {
@@ -1824,6 +3436,10 @@ bool VL53L1XComponent::check_for_dataready(bool *is_dataready) {
 
 // perform sensor read process
 bool VL53L1XComponent::perform_sensor_read() {
+  // a sensor which has lost its configuration is not worth reading
+  if (!this->check_config_image())
+    return false;
+
   if (!read_ranging_results()) {
     ESP_LOGE(TAG, "  Error reading ranging results");
     return false;
@@ -1835,6 +3451,8 @@ bool VL53L1XComponent::perform_sensor_read() {
       return false;
     }
     this->calibrated_ = true;
+    if (this->warm_start_record_pending_)
+      this->update_warm_start_record();
   }
 
   if (!update_dss()) {
@@ -1852,85 +3470,14 @@ bool VL53L1XComponent::perform_sensor_read() {
 }
 
 bool VL53L1XComponent::read_ranging_results() {
-  // if (!this->vl53l1x_read_bytes(RESULT__RANGE_STATUS, reinterpret_cast<uint8_t *>(&this->results_.range_status), 17)) {
-  //   ESP_LOGW(TAG, "Error reading Range Status");
-  //   this->status_set_warning();
-  //   return false;
-  // }
-  uint8_t results_buffer[17];
-  uint8_t status;
-
-  if (!this->vl53l1x_read_bytes(RESULT__RANGE_STATUS, results_buffer, 17)) {
+  uint8_t results_buffer[RANGING_RESULTS_SIZE];
+
+  if (!this->vl53l1x_read_bytes(RESULT__RANGE_STATUS, results_buffer, RANGING_RESULTS_SIZE)) {
     ESP_LOGE(TAG, "  Error reading ranging results");
     return false;
   }
 
-  this->results_.range_status = results_buffer[0];
-  this->results_.stream_count = results_buffer[2];
-
-  this->results_.dss_actual_effective_spads_sd0  = (uint16_t)results_buffer[3] << 8 | results_buffer[4];
-  this->results_.ambient_count_rate_mcps_sd0  = (uint16_t)results_buffer[7] << 8 | results_buffer[8];
-
-  this->results_.final_crosstalk_corrected_range_mm_sd0  = (uint16_t)results_buffer[13] << 8 | results_buffer[14];
-  this->results_.peak_signal_count_rate_crosstalk_corrected_mcps_sd0  = (uint16_t)results_buffer[15] << 8 | results_buffer[16];
-
-
-  switch(this->results_.range_status) {
-    case 9: // RANGECOMPLETE
-      // from VL53L1_copy_sys_and_core_results_to_range_results()
-      if (this->results_.stream_count != 0) {
-        this->range_status_ = RANGE_VALID;
-      }
-      else {
-        this->range_status_ = RANGE_VALID_NOWRAP_CHECK_FAIL; // range valid but wraparound check has not been done
-      }
-      break;
-
-    case 8: // MINCLIP
-      this->range_status_ = RANGE_VALID_MIN_RANGE_CLIPPED; // target is below minimum detection threshold
-      break;
-
-    case 1: // VCSELCONTINUITYTESTFAILURE
-    case 2: // VCSELWATCHDOGTESTFAILURE
-    case 3: // NOVHVVALUEFOUND
-    case 17: // MULTCLIPFAIL
-      // from SetSimpleData()
-      this->range_status_ = HARDWARE_FAIL; // hardware or VCSEL failure
-      break;
-
-    case 4: // MSRCNOTARGET
-      this->range_status_ = SIGNAL_FAIL; // signal value below internal defined threshold
-      break;
-
-    case 5: // RANGEPHASECHECK
-      this->range_status_ =  OUT_OF_BOUNDS_FAIL; // nothing detected in range (try a longer rang mode if applicable)
-      break;
-
-    case 6: // SIGMATHRESHOLDCHECK
-      this->range_status_ = SIGMA_FAIL; // sigma (standard deviation) estimator check is above internally defined threshold
-      break;
-
-    case 7: // PHASECONSISTENCY
-      this->range_status_ = WRAP_TARGET_FAIL; // wrapped target not matching phases, no matching phase in other VCSEL period timing
-      break;
-
-    case 13: // USERROICLIP - target is below minimum detection threshold
-      // from SetSimpleData()
-      this->range_status_ = MIN_RANGE_FAIL;
-      break;
-
-    default:
-      this->range_status_ = UNDEFINED;
-  }
-
-  uint32_t range = static_cast<uint32_t>(this->results_.final_crosstalk_corrected_range_mm_sd0);
-
-  // "apply correction gain"
-  // gain factor of 2011 is tuning parm default (VL53L1_TUNINGPARM_LITE_RANGING_GAIN_FACTOR_DEFAULT)
-  // basically, this appears to scale the result by 2011 / 2048(0x0800) or about 98%
-  // with the 1024(0x0400) added for proper rounding
-  this->distance_ = static_cast<uint16_t>(((range * 2011) + 0x0400) / 0x0800);
-
+  decode_ranging_results(results_buffer, &this->results_);
   return true;
 }
 
@@ -1960,105 +3507,64 @@ bool VL53L1XComponent::setup_manual_calibration() {
 // perform Dynamic SPAD Selection calculation/update
 // based on VL53L1_low_power_auto_update_DSS()
 bool VL53L1XComponent::update_dss() {
-  uint16_t spadCount = this->results_.dss_actual_effective_spads_sd0;
-
-  if (spadCount != 0) {
-    // calc total rate per spad
-    uint32_t totalRatePerSpad =
-      (uint32_t)this->results_.peak_signal_count_rate_crosstalk_corrected_mcps_sd0 +
-      this->results_.ambient_count_rate_mcps_sd0;
-
-    // clip to 16 bits
-    if (totalRatePerSpad > 0xFFFF) { totalRatePerSpad = 0xFFFF; }
-
-    // shift up to take advantage of 32 bits
-    totalRatePerSpad <<= 16;
-
-    totalRatePerSpad /= spadCount;
-
-    if (totalRatePerSpad != 0) {
-      // get the target rate and shift up by 16
-      uint32_t requiredSpads = ((uint32_t)TARGET_RATE << 16) / totalRatePerSpad;
-
-      // clip to 16 bit
-      if (requiredSpads > 0xFFFF) { requiredSpads = 0xFFFF; }
-
-      // override DSS config
-      if (!this->vl53l1x_write_byte_16(DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, requiredSpads)) return false;
-
-      // DSS_CONFIG__ROI_MODE_CONTROL should already be set to REQUESTED_EFFFECTIVE_SPADS
-      return true;
-    }
+  uint16_t required_spads = calculate_required_spads(this->results_.dss_actual_effective_spads_sd0,
+                                                     this->results_.peak_signal_count_rate_crosstalk_corrected_mcps_sd0,
+                                                     this->results_.ambient_count_rate_mcps_sd0,
+                                                     this->dss_target_rate_);
+
+  // the SPADs of the previous frame are close enough, which is usually the case
+  // for a steady target, so save the write
+  if ((this->dss_spads_ != 0) && !dss_change_required(this->dss_spads_, required_spads, DSS_HYSTERESIS_SHIFT)) {
+    this->dss_writes_skipped_++;
+    return true;
   }
 
-  // if we reached this point, it means something above would have resulted in a divide by zero
-  // gracefully set a spad target, not just exit with an error
-
-  // set target to mid point
-  if (!this->vl53l1x_write_byte_16(DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, 0x8000)) return false;
+  // override DSS config
+  // DSS_CONFIG__ROI_MODE_CONTROL should already be set to REQUESTED_EFFFECTIVE_SPADS
+  if (!this->vl53l1x_write_byte_16(DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT, required_spads)) {
+    this->dss_spads_ = 0;
+    return false;
+  }
+  this->dss_spads_ = required_spads;
   return true;
 }
 
-// decode sequence step timeout in MCLKs from register value
-// based on VL53L1_decode_timeout()
-uint32_t VL53L1XComponent::decode_timeout(uint16_t reg_val) {
-  return ((uint32_t)(reg_val & 0xFF) << (reg_val >> 8)) + 1;
-}
-
-// encode sequence step timeout register value from timeout in MCLKs
-// based on VL53L1_encode_timeout()
-uint16_t VL53L1XComponent::encode_timeout(uint32_t timeout_mclks) {
-  // encoded format: (LSByte * 2^MSByte) + 1
-
-  uint32_t ls_byte = 0;
-  uint16_t ms_byte = 0;
-
-  if (timeout_mclks > 0) {
-    ls_byte = timeout_mclks - 1;
+// compare the range configuration registers with what was last written to them,
+// at most every CONFIG_CHECK_INTERVAL so the cost is one transaction in that time
+// returns false on communication failure or if the sensor has lost its
+// configuration, in which case the recovery resets and reconfigures it
+bool VL53L1XComponent::check_config_image() {
+  uint32_t now = millis();
+  if ((this->config_image_written_ == 0) || ((now - this->last_config_check_) < CONFIG_CHECK_INTERVAL))
+    return true;
+  this->last_config_check_ = now;
 
-    while ((ls_byte & 0xFFFFFF00) > 0) {
-      ls_byte >>= 1;
-      ms_byte++;
+  uint8_t image[CONFIG_IMAGE_SIZE];
+  if (!this->vl53l1x_read_bytes(CONFIG_IMAGE_START, image, CONFIG_IMAGE_SIZE)) {
+    ESP_LOGE(TAG, "  Error reading configuration registers");
+    return false;
+  }
+  for (uint8_t i = 0; i < CONFIG_IMAGE_SIZE; i++) {
+    if ((this->config_image_written_ & (1 << i)) && (image[i] != this->config_image_[i])) {
+      this->config_losses_++;
+      ESP_LOGW(TAG, "Sensor has lost its configuration (register 0x%04X is 0x%02X, expected 0x%02X), reconfiguring",
+               CONFIG_IMAGE_START + i, image[i], this->config_image_[i]);
+      this->reset_on_recovery_ = true;
+      return false;
     }
-
-    return (ms_byte << 8) | (ls_byte & 0xFF);
-  } else {
-    return 0;
   }
+  return true;
 }
 
-// convert sequence step timeout from macro periods to microseconds with given
-// macro period in microseconds (12.12 format)
-// based on VL53L1_calc_timeout_us()
-uint32_t VL53L1XComponent::timeout_mclks_to_microseconds(uint32_t timeout_mclks, uint32_t macro_period_us) {
-  return ((uint64_t)timeout_mclks * macro_period_us + 0x800) >> 12;
-}
-
-// convert sequence step timeout from microseconds to macro periods with given
-// macro period in microseconds (12.12 format)
-// based on VL53L1_calc_timeout_mclks()
-uint32_t VL53L1XComponent::timeout_microseconds_to_mclks(uint32_t timeout_us, uint32_t macro_period_us) {
-  return (((uint32_t)timeout_us << 12) + (macro_period_us >> 1)) / macro_period_us;
-}
-
-// calculate macro period in microseconds (12.12 format) with given VCSEL period
-// assumes fast_osc_frequency has been read and stored
-// based on VL53L1_calc_macro_period_us()
-uint32_t VL53L1XComponent::calculate_macro_period(uint8_t vcsel_period) {
-  // from VL53L1_calc_pll_period_us()
-  // fast osc frequency in 4.12 format; PLL period in 0.24 format
-  uint32_t pll_period_us = ((uint32_t)0x01 << 30) / this->fast_osc_frequency_;
-
-  // from VL53L1_decode_vcsel_period()
-  uint8_t vcsel_period_pclks = (vcsel_period + 1) << 1;
-
-  // VL53L1_MACRO_PERIOD_VCSEL_PERIODS = 2304
-  uint32_t macro_period_us = (uint32_t)2304 * pll_period_us;
-  macro_period_us >>= 6;
-  macro_period_us *= vcsel_period_pclks;
-  macro_period_us >>= 6;
-
-  return macro_period_us;
+// keep the bytes of a write which fall in the checked configuration registers
+void VL53L1XComponent::shadow_config_image(uint16_t a_register, const uint8_t *data, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) {
+    uint16_t reg = a_register + i;
+    if ((reg < CONFIG_IMAGE_START) || (reg >= (CONFIG_IMAGE_START + CONFIG_IMAGE_SIZE)))
+      continue;
+    this->config_image_[reg - CONFIG_IMAGE_START] = data[i];
+    this->config_image_written_ |= (1 << (reg - CONFIG_IMAGE_START));
+  }
 }
 
 std::string VL53L1XComponent::range_status_to_string() {
@@ -2095,20 +3601,38 @@ std::string VL53L1XComponent::range_status_to_string() {
   }
 }
 
+// all register access goes through vl53l1x_write_bytes() and vl53l1x_read_bytes(),
+// which retry a failed transaction before reporting failure, count the bus cost
+// and, at very verbose log level, trace each transaction (see tests/trace_test.cpp)
 bool VL53L1XComponent::vl53l1x_write_bytes(uint16_t a_register, const uint8_t *data, uint8_t len) {
-    return this->write_register16(a_register, data, len) == i2c::ERROR_OK;
+  ESP_LOGVV(TAG, "I2C W 0x%04X: %s", a_register, format_hex_pretty(data, len).c_str());
+  for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+    this->bus_transactions_++;
+    this->bus_bytes_ += len;
+#ifdef VL53L1X_SIMULATION
+    bool ok = this->simulated_sensor_.write(micros(), a_register, data, len);
+#else
+    bool ok = (this->write_register16(a_register, data, len) == i2c::ERROR_OK);
+#endif
+    if (ok) {
+      this->shadow_config_image(a_register, data, len);
+      return true;
+    }
+    this->bus_failures_++;
+  }
+  return false;
 }
 
 bool VL53L1XComponent::vl53l1x_write_byte(uint16_t a_register, uint8_t data) {
     return this->vl53l1x_write_bytes(a_register, &data, 1);
 }
 
-bool VL53L1XComponent::vl53l1x_write_bytes_16(uint8_t a_register, const uint16_t *data, uint8_t len) {
+bool VL53L1XComponent::vl53l1x_write_bytes_16(uint16_t a_register, const uint16_t *data, uint8_t len) {
   // we have to copy in order to be able to change byte order
   std::unique_ptr<uint16_t[]> temp{new uint16_t[len]};
   for (size_t i = 0; i < len; i++)
-    temp[i] = i2c::htoi2cs(data[i]);
-  return (this->write_register16(a_register, reinterpret_cast<const uint8_t *>(temp.get()), len * 2) == i2c::ERROR_OK);
+    temp[i] = convert_big_endian(data[i]);
+  return this->vl53l1x_write_bytes(a_register, reinterpret_cast<const uint8_t *>(temp.get()), len * 2);
 }
 
 bool VL53L1XComponent::vl53l1x_write_byte_16(uint16_t a_register, uint16_t data) {
@@ -2116,18 +3640,32 @@ bool VL53L1XComponent::vl53l1x_write_byte_16(uint16_t a_register, uint16_t data)
 }
 
 bool VL53L1XComponent::vl53l1x_read_bytes(uint16_t a_register, uint8_t *data, uint8_t len) {
-    return this->read_register16(a_register, data, len) == i2c::ERROR_OK;
+  for (uint8_t attempt = 0; attempt <= I2C_RETRIES; attempt++) {
+    this->bus_transactions_++;
+    this->bus_bytes_ += len;
+#ifdef VL53L1X_SIMULATION
+    bool ok = this->simulated_sensor_.read(micros(), a_register, data, len);
+#else
+    bool ok = (this->read_register16(a_register, data, len) == i2c::ERROR_OK);
+#endif
+    if (ok) {
+      ESP_LOGVV(TAG, "I2C R 0x%04X: %s", a_register, format_hex_pretty(data, len).c_str());
+      return true;
+    }
+    this->bus_failures_++;
+  }
+  return false;
 }
 
 bool VL53L1XComponent::vl53l1x_read_byte(uint16_t a_register, uint8_t *data) {
-    return this->read_register16(a_register, data, 1) == i2c::ERROR_OK;
+    return this->vl53l1x_read_bytes(a_register, data, 1);
 }
 
 bool VL53L1XComponent::vl53l1x_read_bytes_16(uint16_t a_register, uint16_t *data, uint8_t len) {
-  if (this->read_register16(a_register, reinterpret_cast<uint8_t *>(data), len * 2) != i2c::ERROR_OK)
+  if (!this->vl53l1x_read_bytes(a_register, reinterpret_cast<uint8_t *>(data), len * 2))
     return false;
   for (size_t i = 0; i < len; i++)
-    data[i] = i2c::i2ctohs(data[i]);
+    data[i] = convert_big_endian(data[i]);
   return true;
 }
 
@@ -1,64 +1,238 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
 #include "esphome/components/sensor/sensor.h"
+#ifdef VL53L1X_SIMULATION
+#include "simulated_sensor.h"
+#else
 #include "esphome/components/i2c/i2c.h"
+#endif
+#ifdef USE_BINARY_SENSOR
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#endif
+#ifdef VL53L1X_SAMPLE_EXPORT
+#include "esphome/components/uart/uart.h"
+#endif
+#include "vl53l1x_calc.h"
+#include "people_counter.h"
+#include "kalman_tracker.h"
+#include "presence_detector.h"
+#include "distance_mode_selector.h"
+#include "sample_queue.h"
+
+#include <atomic>
+
+#ifdef VL53L1X_ACQUISITION_TASK
+#ifdef USE_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#else
+#include <thread>
+#endif
+#endif
+
+#if defined(VL53L1X_VARIANT_VL53L1X) && defined(VL53L1X_VARIANT_VL53L4CD)
+#error "All vl53l1x sensors in one configuration must use the same variant"
+#endif
 
 namespace esphome {
 namespace vl53l1x {
 
+// ROI_CONFIG__USER_ROI_CENTRE_SPAD at the centre of the SPAD array
+static const uint8_t ROI_CENTER_DEFAULT = 199;
+
+// values of IDENTIFICATION__MODEL_ID
+static const uint16_t VL53L1X_MODEL_ID  = 0xEACC;
+static const uint16_t VL53L4CD_MODEL_ID = 0xEBAA;
+
 enum DistanceMode {
   SHORT = 0,
   LONG,
 };
 
-// to store ranging results which are read from registers
-// RESULT__RANGE_STATUS (0x0089) to
-// RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0_LOW (0x0099)
-struct RangingResults {
-  uint8_t  range_status;
-  uint8_t  report_status;                   // not used
-  uint8_t  stream_count;
-  uint16_t dss_actual_effective_spads_sd0;
-  uint16_t peak_signal_count_rate_mcps_sd0; // not used
-  uint16_t ambient_count_rate_mcps_sd0;
-  uint16_t sigma_sd0;                       // not used
-  uint16_t phase_sd0;                       // not used
-  uint16_t final_crosstalk_corrected_range_mm_sd0;
-  uint16_t peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+enum Preset {
+  PRESET_LOW_POWER = 0,  // one-shot ranging started by update(), low power auto timing
+  PRESET_HIGH_RATE,      // VL53L4CD back-to-back continuous ranging
 };
 
-class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public sensor::Sensor {
+enum BurstAverage {
+  BURST_MEDIAN = 0,
+  BURST_TRIMMED_MEAN,  // mean without the lowest and highest quarter
+};
+
+// most one-shots ranged back to back for each update in burst mode
+static const uint8_t BURST_COUNT_MAX = 16;
+
+// bytes of configuration registers read back to check the sensor has not reset itself
+static const uint8_t CONFIG_IMAGE_SIZE = 12;
+
+// ROI chosen by the alignment scan, saved to flash and applied at boot
+// width 0 means there is no saved ROI
+struct RoiCalibration {
+  uint8_t width;
+  uint8_t height;
+  uint8_t center;
+};
+
+// the configuration the sensor was left with, saved so that after a restart of
+// only the MCU the sensor can keep it instead of being reset and reprogrammed
+// signature 0 means there is no valid record
+struct WarmStartRecord {
+  uint32_t signature;
+  uint16_t image_written;
+  uint8_t image[CONFIG_IMAGE_SIZE];
+  uint8_t vhv_init;
+  uint8_t vhv_timeout;
+};
+
+class VL53L1XComponent : public PollingComponent,
+#ifndef VL53L1X_SIMULATION
+                         public i2c::I2CDevice,
+#endif
+                         public sensor::Sensor {
  public:
   void set_distance_sensor(sensor::Sensor *distance_sensor) { distance_sensor_ = distance_sensor; }
   void set_range_status_sensor(sensor::Sensor *range_status_sensor) { range_status_sensor_ = range_status_sensor; }
+  void set_sample_rate_sensor(sensor::Sensor *sample_rate_sensor) { sample_rate_sensor_ = sample_rate_sensor; }
+  void set_valid_rate_sensor(sensor::Sensor *valid_rate_sensor) { valid_rate_sensor_ = valid_rate_sensor; }
+  void set_sigma_fail_rate_sensor(sensor::Sensor *sigma_fail_rate_sensor) {
+    sigma_fail_rate_sensor_ = sigma_fail_rate_sensor;
+  }
+  void set_signal_fail_rate_sensor(sensor::Sensor *signal_fail_rate_sensor) {
+    signal_fail_rate_sensor_ = signal_fail_rate_sensor;
+  }
+  void set_entry_count_sensor(sensor::Sensor *entry_count_sensor) { entry_count_sensor_ = entry_count_sensor; }
+  void set_exit_count_sensor(sensor::Sensor *exit_count_sensor) { exit_count_sensor_ = exit_count_sensor; }
+  void set_occupancy_sensor(sensor::Sensor *occupancy_sensor) { occupancy_sensor_ = occupancy_sensor; }
+  void set_filtered_distance_sensor(sensor::Sensor *filtered_distance_sensor) {
+    filtered_distance_sensor_ = filtered_distance_sensor;
+  }
+  void set_velocity_sensor(sensor::Sensor *velocity_sensor) { velocity_sensor_ = velocity_sensor; }
+  void set_start_latency_sensor(sensor::Sensor *start_latency_sensor) { start_latency_sensor_ = start_latency_sensor; }
+  void set_completion_latency_sensor(sensor::Sensor *completion_latency_sensor) {
+    completion_latency_sensor_ = completion_latency_sensor;
+  }
+  void set_sample_interval_sensor(sensor::Sensor *sample_interval_sensor) {
+    sample_interval_sensor_ = sample_interval_sensor;
+  }
+  void set_sample_jitter_sensor(sensor::Sensor *sample_jitter_sensor) { sample_jitter_sensor_ = sample_jitter_sensor; }
+#ifdef VL53L1X_SAMPLE_EXPORT
+  void set_export_uart(uart::UARTComponent *export_uart) { export_uart_ = export_uart; }
+#endif
+#ifdef USE_BINARY_SENSOR
+  void set_presence_binary_sensor(binary_sensor::BinarySensor *presence_binary_sensor) {
+    presence_binary_sensor_ = presence_binary_sensor;
+  }
+#endif
   void config_distance_mode(DistanceMode distance_mode ) { distance_mode_ = distance_mode; }
+  void config_auto_distance_mode() { auto_distance_mode_ = true; }
+  void set_distance_mode_switches_sensor(sensor::Sensor *distance_mode_switches_sensor) {
+    distance_mode_switches_sensor_ = distance_mode_switches_sensor;
+  }
+  void config_preset(Preset preset) { preset_ = preset; }
+  void config_timing_budget(uint16_t timing_budget_ms) { timing_budget_ = timing_budget_ms; }
+  // replace the preset defaults for frames to be SIGMA_FAIL or SIGNAL_FAIL
+  void config_sigma_threshold(float sigma_mm) { sigma_threshold_ = sigma_to_register(sigma_mm); }
+  void config_signal_threshold(float signal_mcps) { signal_threshold_ = signal_rate_to_register(signal_mcps); }
+  // total signal and ambient rate in Mcps that dynamic SPAD selection aims for
+  void config_dss_target_rate(float target_mcps) { dss_target_rate_ = signal_rate_to_register(target_mcps); }
+#ifdef VL53L1X_SIMULATION
+  void config_simulation(bool vl53l4cd, uint16_t distance_mm, uint16_t amplitude_mm, uint32_t period_ms,
+                         uint16_t noise_mm, float dropout_probability, float error_probability, float speed) {
+    simulated_sensor_.set_model_id(vl53l4cd ? VL53L4CD_MODEL_ID : VL53L1X_MODEL_ID);
+    simulated_sensor_.set_distance(distance_mm);
+    simulated_sensor_.set_movement(amplitude_mm, period_ms);
+    simulated_sensor_.set_noise(noise_mm);
+    simulated_sensor_.set_dropout_probability(dropout_probability);
+    simulated_sensor_.set_error_probability(error_probability);
+    simulated_sensor_.set_speed(speed);
+  }
+  const SimulatedSensor &get_simulated_sensor() const { return this->simulated_sensor_; }
+#endif
+#ifdef VL53L1X_ACQUISITION_TASK
+  void config_acquisition_task(bool shared_bus) {
+    acquisition_task_ = true;
+    shared_bus_ = shared_bus;
+  }
+#endif
+  void config_people_counter(uint16_t threshold_mm, uint8_t roi_width, uint8_t roi_height,
+                             uint8_t zone_0_centre, uint8_t zone_1_centre) {
+    people_counting_ = true;
+    people_threshold_ = threshold_mm;
+    roi_width_ = roi_width;
+    roi_height_ = roi_height;
+    zone_centre_[0] = zone_0_centre;
+    zone_centre_[1] = zone_1_centre;
+  }
+  void config_pipelined() { pipelined_ = true; }
+  void config_warm_start() { warm_start_ = true; }
+  void config_burst(uint8_t count, BurstAverage average) {
+    burst_count_ = count;
+    burst_average_ = average;
+  }
+  void set_burst_spread_sensor(sensor::Sensor *burst_spread_sensor) { burst_spread_sensor_ = burst_spread_sensor; }
+  void config_recalibration(uint32_t interval_ms, float sigma_increase, float valid_drop) {
+    recalibration_ = true;
+    recalibration_interval_ = interval_ms;
+    recalibration_sigma_increase_ = sigma_increase;
+    recalibration_valid_drop_ = valid_drop;
+  }
+  void config_tracker(float acceleration_noise) {
+    tracking_ = true;
+    tracker_.set_acceleration_noise(acceleration_noise);
+  }
+  void config_presence(uint16_t enter_distance_mm, uint16_t leave_distance_mm, uint32_t enter_delay_ms,
+                       uint32_t leave_delay_ms, uint32_t dwell_time_ms) {
+    presence_detection_ = true;
+    presence_detector_.configure(enter_distance_mm, leave_distance_mm, enter_delay_ms, leave_delay_ms, dwell_time_ms);
+  }
+
+  void add_on_presence_callback(std::function<void(PresenceDetector::Event)> &&callback) {
+    this->presence_callback_.add(std::move(callback));
+  }
 
   void setup() override;
   void dump_config() override;
   void update() override;
   void loop() override;
   float get_setup_priority() const override;
+#ifdef VL53L1X_ACQUISITION_TASK
+  void on_shutdown() override;
+  ~VL53L1XComponent();
+#endif
 
   std::string range_status_to_string();
 
+  // runtime reconfiguration, applied from loop() without blocking
+  void request_distance_mode(DistanceMode distance_mode);
+  void request_timing_budget(uint16_t timing_budget_ms);
+  void request_roi(uint8_t width, uint8_t height, uint8_t center);
+  void request_thresholds(float sigma_mm, float signal_mcps);
+  // scan ROI centres and sizes for the one giving the best frames, and save it
+  void request_roi_calibration();
+  void reset_roi_calibration();
+
  protected:
   DistanceMode distance_mode_;
+  Preset preset_{PRESET_LOW_POWER};
+  uint16_t timing_budget_{500};
+  uint8_t roi_width_{4};
+  uint8_t roi_height_{4};
+  uint8_t roi_center_{ROI_CENTER_DEFAULT};
+  // RANGE_CONFIG__SIGMA_THRESH (14.2 format mm) and RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS
+  // (9.7 format Mcps), 0 until set from the preset defaults
+  uint16_t sigma_threshold_{0};
+  uint16_t signal_threshold_{0};
+  // DSS_CONFIG__TARGET_TOTAL_RATE_MCPS (9.7 format Mcps), 0 until set to the default
+  uint16_t dss_target_rate_{0};
 
   uint16_t distance_{0};
 
-  enum RangeStatus {
-    RANGE_VALID = 0,
-    RANGE_VALID_NOWRAP_CHECK_FAIL,
-    RANGE_VALID_MIN_RANGE_CLIPPED,
-    HARDWARE_FAIL,
-    SIGNAL_FAIL,
-    OUT_OF_BOUNDS_FAIL,
-    SIGMA_FAIL,
-    WRAP_TARGET_FAIL,
-    MIN_RANGE_FAIL,
-    UNDEFINED,
-  } range_status_{UNDEFINED};
+  RangeStatus range_status_{UNDEFINED};
 
   enum ErrorCode {
     NONE = 0,
@@ -69,8 +243,45 @@ class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public
     CONFIG_FAILED,
     SET_MODE_FAILED,
     START_RANGING_FAILED,
-    SENSOR_READ_FAILED,
-  } error_code_{NONE};
+  };
+  // set by whichever context resets the sensor, reported by dump_config()
+  std::atomic<ErrorCode> error_code_{NONE};
+
+  // when a variant is selected in yaml this is a compile-time constant,
+  // so code only needed by the other variant is removed by the compiler
+  bool is_vl53l4cd() const {
+#if defined(VL53L1X_VARIANT_VL53L4CD)
+    return true;
+#elif defined(VL53L1X_VARIANT_VL53L1X)
+    return false;
+#else
+    return this->sensor_id_ == VL53L4CD_MODEL_ID;
+#endif
+  }
+
+  // ranging is driven from loop() rather than started by each update()
+  bool free_running() const {
+    return (this->preset_ == PRESET_HIGH_RATE) || this->people_counting_ || this->pipelined_;
+  }
+
+  void resolve_settings();
+  bool init_sensor();
+  bool warm_start();
+  uint32_t config_signature() const;
+  void update_warm_start_record();
+  void invalidate_warm_start_record();
+  bool start_ranging();
+  void start_recovery();
+  bool apply_pending_config();
+  void request_recalibration(const char *reason);
+  void queue_distance_mode(DistanceMode distance_mode);
+  uint32_t preference_hash(const char *name) const;
+  RoiCalibration roi_scan_candidate(uint8_t index) const;
+  bool start_roi_scan();
+  bool start_roi_scan_candidate();
+  bool roi_scan_step();
+  bool finish_roi_scan();
+  void recover();
 
   bool get_sensor_id(bool *valid_sensor);
   bool boot_state(uint8_t *state);
@@ -79,6 +290,9 @@ class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public
   bool get_timing_budget(uint16_t *timing_budget_ms);
 
   bool set_roi_size(uint8_t width, uint8_t height);
+  bool set_roi_center(uint8_t spad_number);
+
+  bool set_thresholds(uint16_t sigma_threshold, uint16_t signal_threshold);
 
   bool set_distance_mode(DistanceMode distance_mode);
   bool get_distance_mode(DistanceMode *mode);
@@ -87,24 +301,55 @@ class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public
   bool stop_continuous();
 
   bool start_oneshot();
-
+  bool start_next_oneshot();
+
+  uint32_t timing_guard_us() const;
+  bool read_continuous();
+#ifdef VL53L1X_ACQUISITION_TASK
+  bool start_acquisition_task();
+  void stop_acquisition_task();
+  static void acquisition_task(void *param);
+  uint32_t acquisition_step();
+  uint32_t acquisition_wait_us();
+  bool acquire_bus();
+  void release_bus();
+  void lend_bus();
+#endif
+  bool yield_bus();
+  void drain_samples();
+  bool read_people_counter();
+  bool read_pipelined();
+  void publish_people_counts();
+  Sample make_sample(uint32_t start_us) const;
+  void process_sample(const Sample &sample);
+  void update_tracker(const Sample &sample);
+#ifdef VL53L1X_SAMPLE_EXPORT
+  void export_sample(const Sample &sample);
+#endif
+  void update_presence();
+  void update_recalibration(const Sample &sample);
+  void update_distance_mode(const Sample &sample);
+  bool add_burst_sample();
+  void publish_results();
+  void update_sample_interval();
+  void publish_sample_interval();
+  void publish_status_counts(uint32_t elapsed_ms);
+
+  uint32_t dataready_poll_wait(uint32_t now) const;
+  bool poll_dataready(bool *is_dataready);
   bool check_for_dataready(bool *is_dataready);
 
   bool perform_sensor_read();
   bool read_ranging_results();
   bool setup_manual_calibration();
   bool update_dss();
-
-  uint32_t decode_timeout(uint16_t reg_val);
-  uint16_t encode_timeout(uint32_t timeout_mclks);
-  uint32_t timeout_mclks_to_microseconds(uint32_t timeout_mclks, uint32_t macro_period_us);
-  uint32_t timeout_microseconds_to_mclks(uint32_t timeout_us, uint32_t macro_period_us);
-  uint32_t calculate_macro_period(uint8_t vcsel_period);
+  bool check_config_image();
+  void shadow_config_image(uint16_t a_register, const uint8_t *data, uint8_t len);
 
   bool vl53l1x_write_bytes(uint16_t a_register, const uint8_t *data, uint8_t len);
   bool vl53l1x_write_byte(uint16_t a_register, uint8_t data);
 
-  bool vl53l1x_write_bytes_16(uint8_t a_register, const uint16_t *data, uint8_t len);
+  bool vl53l1x_write_bytes_16(uint16_t a_register, const uint16_t *data, uint8_t len);
   bool vl53l1x_write_byte_16(uint16_t a_register, uint16_t data);
 
 
@@ -115,6 +360,16 @@ class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public
   bool vl53l1x_read_byte_16(uint16_t a_register, uint16_t *data);
 
 
+  // bus cost, every attempt at a transaction is counted, including retries
+  // written by whichever context owns the bus and read by update() for logging
+  std::atomic<uint32_t> bus_transactions_{0};
+  std::atomic<uint32_t> bus_bytes_{0};
+  std::atomic<uint32_t> bus_failures_{0};
+  uint32_t setup_transactions_{0};
+  uint32_t setup_bytes_{0};
+  uint32_t reported_transactions_{0};
+  uint32_t reported_bytes_{0};
+
   // pololu globals
   bool calibrated_{false};
   uint8_t saved_vhv_init_{0};
@@ -123,17 +378,207 @@ class VL53L1XComponent : public PollingComponent, public i2c::I2CDevice, public
   uint16_t fast_osc_frequency_;
   uint16_t osc_calibrate_val_;
 
+  // range configuration registers as last written, with a bit for each byte written
+  // since the last reset, compared with the sensor every CONFIG_CHECK_INTERVAL
+  uint8_t config_image_[CONFIG_IMAGE_SIZE]{};
+  uint16_t config_image_written_{0};
+  uint32_t last_config_check_{0};
+  uint32_t config_losses_{0};
+
+  // DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT as last written, 0 if not known
+  uint16_t dss_spads_{0};
+  std::atomic<uint32_t> dss_writes_skipped_{0};
+
   RangingResults results_;
 
   // internal
   bool distance_mode_overriden_{false};
+  bool preset_overriden_{false};
+  bool new_sample_{false};
+  uint32_t sample_count_{0};
+  // samples of each RangeStatus since the previous update
+  uint32_t status_counts_[UNDEFINED + 1]{};
+  uint32_t last_update_time_{0};
+  HighFrequencyLoopRequester high_freq_;
+
+  // runtime reconfiguration
+  uint8_t pending_config_{0};
+  DistanceMode pending_distance_mode_{SHORT};
+  uint16_t pending_timing_budget_{0};
+  uint8_t pending_roi_width_{0};
+  uint8_t pending_roi_height_{0};
+  uint8_t pending_roi_center_{ROI_CENTER_DEFAULT};
+  uint16_t pending_sigma_threshold_{0};
+  uint16_t pending_signal_threshold_{0};
+  uint32_t config_request_us_{0};
+  // requests may come from the main loop while the acquisition task reconfigures,
+  // the settings it applies are also read by the main loop with the lock held
+  Mutex config_lock_;
+
+  // timestamps of the latest sample in micros(), when its frame was started and found complete
+  uint32_t sample_start_us_{0};
+  uint32_t sample_ready_us_{0};
+  // sampling interval statistics since the previous update (Welford's algorithm)
+  uint32_t last_sample_ready_us_{0};
+  uint32_t interval_count_{0};
+  float interval_mean_us_{0};
+  float interval_m2_{0};
+
+  // automatic SHORT/LONG switching, switches are counted and the time
+  // from the decision to ranging in the new mode is kept for reporting
+  bool auto_distance_mode_{false};
+  DistanceModeSelector distance_mode_selector_;
+  uint32_t distance_mode_switches_{0};
+  uint32_t reported_distance_mode_switches_{0};
+  uint32_t distance_mode_switch_us_{0};
+
+  // warm start, the record is built where the sensor is read and saved from the main loop,
+  // once ranging has started it is only accessed with config_lock_ held
+  bool warm_start_{false};
+  bool warm_started_{false};
+  ESPPreferenceObject warm_start_pref_;
+  WarmStartRecord warm_start_record_{};
+  bool warm_start_record_pending_{false};
+  std::atomic<bool> warm_start_save_{false};
+
+  // ROI alignment scan, candidates are ranged in turn and the best is saved
+  ESPPreferenceObject roi_pref_;
+  RoiCalibration configured_roi_{0, 0, 0};
+  bool roi_calibrated_{false};
+  bool roi_scan_requested_{false};
+  bool roi_scan_active_{false};
+  uint8_t roi_scan_index_{0};
+  uint8_t roi_scan_frames_{0};
+  uint8_t roi_scan_valid_{0};
+  uint32_t roi_scan_signal_{0};
+  uint32_t roi_scan_sigma_{0};
+  float roi_scan_best_score_{0};
+  RoiCalibration roi_scan_best_{0, 0, 0};
+  uint32_t roi_scan_start_time_{0};
+
+  // scheduled recalibration of VHV and phasecal, on an interval (0 disables)
+  // or when the frame statistics degrade (increase or drop of 0 disables)
+  bool recalibration_{false};
+  uint32_t recalibration_interval_{0};
+  float recalibration_sigma_increase_{0};
+  float recalibration_valid_drop_{0};
+  uint32_t last_calibration_time_{0};
+  uint32_t recalibration_count_{0};
+  uint16_t window_frames_{0};
+  uint16_t window_valid_{0};
+  uint32_t window_sigma_{0};
+  bool baseline_set_{false};
+  float baseline_valid_{0};
+  float baseline_sigma_mm_{0};
+
+  // low power one-shots back to back, each started as soon as the previous frame is read
+  bool pipelined_{false};
+
+  // burst of one-shots combined into one published distance
+  uint8_t burst_count_{0};
+  BurstAverage burst_average_{BURST_MEDIAN};
+  uint8_t burst_frames_{0};
+  uint8_t burst_valid_{0};
+  uint16_t burst_distances_[BURST_COUNT_MAX];
+  float burst_spread_{NAN};
+  RangeStatus burst_status_{RANGE_VALID};
+
+  // distance and velocity tracking
+  bool tracking_{false};
+  KalmanTracker tracker_;
+  // set where a distance mode or ROI change is applied, the tracker is
+  // reset by the first sample started after tracker_restart_us_
+  std::atomic<bool> tracker_restart_{false};
+  std::atomic<uint32_t> tracker_restart_us_{0};
+  uint32_t tracker_us_max_{0};
+  uint32_t tracker_rejections_{0};
+
+  // presence detection
+  bool presence_detection_{false};
+  PresenceDetector presence_detector_;
+  CallbackManager<void(PresenceDetector::Event)> presence_callback_;
+
+  // communication failure recovery
+  std::atomic<bool> recovering_{false};
+  uint8_t recovery_attempts_{0};
+  uint32_t recovery_start_time_{0};
+  uint32_t next_recovery_time_{0};
+  uint32_t recovery_count_{0};
+  // the sensor may not hold the configured settings, so recover by reset
+  bool reset_on_recovery_{false};
+
+  // people counting
+  bool people_counting_{false};
+  PeopleCounter people_counter_;
+  uint16_t people_threshold_{0};
+  uint8_t zone_centre_[PEOPLE_COUNTER_ZONES]{0, 0};
+  uint8_t zone_{0};
+  uint32_t zone_process_us_max_{0};
   bool ranging_active_{false};
   uint16_t sensor_id_{0};
-  uint32_t last_loop_time_{0};
+  uint32_t frame_start_us_{0};
+  uint32_t frame_ready_us_{0};
+  uint32_t last_poll_us_{0};
+  // moving average of the frame completion time, also logged by update()
+  std::atomic<uint32_t> completion_us_{0};
+  uint16_t frame_budget_ms_{0};
+  uint16_t dataready_polls_{0};
+
+  // continuous ranging hands samples from the reader to processing through a queue
+  SampleQueue sample_queue_;
+  uint32_t reported_overflows_{0};
+
+#ifdef VL53L1X_SAMPLE_EXPORT
+  // every processed sample is written as a binary record
+  uart::UARTComponent *export_uart_{nullptr};
+  uint8_t export_sequence_{0};
+#endif
+
+#ifdef VL53L1X_SIMULATION
+  // takes the place of the I2C bus
+  SimulatedSensor simulated_sensor_;
+#endif
+
+  // the acquisition task owns the ranging cycle, the main loop only processes samples
+  bool acquisition_task_{false};
+#ifdef VL53L1X_ACQUISITION_TASK
+  bool shared_bus_{true};
+  std::atomic<bool> bus_request_{false};
+  std::atomic<bool> bus_granted_{false};
+  // set while the task holds a shared bus, so long waits can give it back
+  bool bus_held_{false};
+  std::atomic<bool> task_stop_{false};
+#ifdef USE_ESP32
+  TaskHandle_t task_handle_{nullptr};
+  // given by release_bus() to the main loop waiting in lend_bus(), and by the task as it stops
+  SemaphoreHandle_t bus_released_{nullptr};
+  SemaphoreHandle_t task_done_{nullptr};
+#else
+  std::thread task_thread_;
+#endif
+#endif
 
   // sensors
   sensor::Sensor *distance_sensor_{nullptr};
   sensor::Sensor *range_status_sensor_{nullptr};
+  sensor::Sensor *sample_rate_sensor_{nullptr};
+  sensor::Sensor *valid_rate_sensor_{nullptr};
+  sensor::Sensor *sigma_fail_rate_sensor_{nullptr};
+  sensor::Sensor *signal_fail_rate_sensor_{nullptr};
+  sensor::Sensor *entry_count_sensor_{nullptr};
+  sensor::Sensor *exit_count_sensor_{nullptr};
+  sensor::Sensor *occupancy_sensor_{nullptr};
+  sensor::Sensor *filtered_distance_sensor_{nullptr};
+  sensor::Sensor *velocity_sensor_{nullptr};
+  sensor::Sensor *burst_spread_sensor_{nullptr};
+  sensor::Sensor *distance_mode_switches_sensor_{nullptr};
+  sensor::Sensor *start_latency_sensor_{nullptr};
+  sensor::Sensor *completion_latency_sensor_{nullptr};
+  sensor::Sensor *sample_interval_sensor_{nullptr};
+  sensor::Sensor *sample_jitter_sensor_{nullptr};
+#ifdef USE_BINARY_SENSOR
+  binary_sensor::BinarySensor *presence_binary_sensor_{nullptr};
+#endif
 };
 
 }  // namespace vl53l1x
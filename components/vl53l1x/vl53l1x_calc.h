@@ -0,0 +1,266 @@
+#pragma once
+
+// Pure integer computation used by the VL53L1X component,
+// also built on the host by the fuzz target and benchmark in tests/.
+
+#include <cstdint>
+
+namespace esphome {
+namespace vl53l1x {
+
+// range status values published by the component
+// (these differ from the values used by the Polulo Arduino Library)
+enum RangeStatus : uint8_t {
+  RANGE_VALID = 0,
+  RANGE_VALID_NOWRAP_CHECK_FAIL,
+  RANGE_VALID_MIN_RANGE_CLIPPED,
+  HARDWARE_FAIL,
+  SIGNAL_FAIL,
+  OUT_OF_BOUNDS_FAIL,
+  SIGMA_FAIL,
+  WRAP_TARGET_FAIL,
+  MIN_RANGE_FAIL,
+  UNDEFINED,
+};
+
+// ROI_CONFIG__USER_ROI_CENTRE_SPAD of the SPAD at column and row (0 to 15)
+// of the SPAD array, numbered as in the UM2555 SPAD map with row 0 at the top
+inline uint8_t roi_center_spad(uint8_t column, uint8_t row) {
+  if (row < 8)
+    return 128 + column * 8 + row;
+  return (15 - column) * 8 + (15 - row);
+}
+
+// to store ranging results which are read from registers
+// RESULT__RANGE_STATUS (0x0089) to
+// RESULT__PEAK_SIGNAL_COUNT_RATE_CROSSTALK_CORRECTED_MCPS_SD0_LOW (0x0099)
+static const uint8_t RANGING_RESULTS_SIZE = 17;
+
+struct RangingResults {
+  uint8_t  range_status;
+  uint8_t  report_status;                   // not used
+  uint8_t  stream_count;
+  uint16_t dss_actual_effective_spads_sd0;
+  uint16_t peak_signal_count_rate_mcps_sd0; // not used
+  uint16_t ambient_count_rate_mcps_sd0;
+  uint16_t sigma_sd0;
+  uint16_t phase_sd0;                       // not used
+  uint16_t final_crosstalk_corrected_range_mm_sd0;
+  uint16_t peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+};
+
+// unpack the big-endian result block read from RESULT__RANGE_STATUS
+inline void decode_ranging_results(const uint8_t *buffer, RangingResults *results) {
+  results->range_status = buffer[0];
+  results->report_status = buffer[1];
+  results->stream_count = buffer[2];
+  results->dss_actual_effective_spads_sd0 = (uint16_t)buffer[3] << 8 | buffer[4];
+  results->peak_signal_count_rate_mcps_sd0 = (uint16_t)buffer[5] << 8 | buffer[6];
+  results->ambient_count_rate_mcps_sd0 = (uint16_t)buffer[7] << 8 | buffer[8];
+  results->sigma_sd0 = (uint16_t)buffer[9] << 8 | buffer[10];
+  results->phase_sd0 = (uint16_t)buffer[11] << 8 | buffer[12];
+  results->final_crosstalk_corrected_range_mm_sd0 = (uint16_t)buffer[13] << 8 | buffer[14];
+  results->peak_signal_count_rate_crosstalk_corrected_mcps_sd0 = (uint16_t)buffer[15] << 8 | buffer[16];
+}
+
+// map the device range status to the range status published by the component
+inline RangeStatus map_range_status(uint8_t device_status, uint8_t stream_count) {
+  switch (device_status) {
+    case 9: // RANGECOMPLETE
+      // from VL53L1_copy_sys_and_core_results_to_range_results()
+      if (stream_count != 0) {
+        return RANGE_VALID;
+      }
+      return RANGE_VALID_NOWRAP_CHECK_FAIL; // range valid but wraparound check has not been done
+
+    case 8: // MINCLIP
+      return RANGE_VALID_MIN_RANGE_CLIPPED; // target is below minimum detection threshold
+
+    case 1: // VCSELCONTINUITYTESTFAILURE
+    case 2: // VCSELWATCHDOGTESTFAILURE
+    case 3: // NOVHVVALUEFOUND
+    case 17: // MULTCLIPFAIL
+      // from SetSimpleData()
+      return HARDWARE_FAIL; // hardware or VCSEL failure
+
+    case 4: // MSRCNOTARGET
+      return SIGNAL_FAIL; // signal value below internal defined threshold
+
+    case 5: // RANGEPHASECHECK
+      return OUT_OF_BOUNDS_FAIL; // nothing detected in range (try a longer rang mode if applicable)
+
+    case 6: // SIGMATHRESHOLDCHECK
+      return SIGMA_FAIL; // sigma (standard deviation) estimator check is above internally defined threshold
+
+    case 7: // PHASECONSISTENCY
+      return WRAP_TARGET_FAIL; // wrapped target not matching phases, no matching phase in other VCSEL period timing
+
+    case 13: // USERROICLIP - target is below minimum detection threshold
+      // from SetSimpleData()
+      return MIN_RANGE_FAIL;
+
+    default:
+      return UNDEFINED;
+  }
+}
+
+// "apply correction gain"
+// gain factor of 2011 is tuning parm default (VL53L1_TUNINGPARM_LITE_RANGING_GAIN_FACTOR_DEFAULT)
+// basically, this appears to scale the result by 2011 / 2048(0x0800) or about 98%
+// with the 1024(0x0400) added for proper rounding
+inline uint16_t apply_range_gain(uint16_t range_mm) {
+  return static_cast<uint16_t>(((static_cast<uint32_t>(range_mm) * 2011) + 0x0400) / 0x0800);
+}
+
+// RANGE_CONFIG__SIGMA_THRESH of a sigma in mm (14.2 format)
+inline uint16_t sigma_to_register(float sigma_mm) {
+  return static_cast<uint16_t>(sigma_mm * 4.0f + 0.5f);
+}
+
+// RANGE_CONFIG__MIN_COUNT_RATE_RTN_LIMIT_MCPS of a return signal rate in Mcps (9.7 format)
+inline uint16_t signal_rate_to_register(float signal_mcps) {
+  return static_cast<uint16_t>(signal_mcps * 128.0f + 0.5f);
+}
+
+// Dynamic SPAD Selection calculation, returns the value for
+// DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT
+// based on VL53L1_low_power_auto_update_DSS()
+inline uint16_t calculate_required_spads(uint16_t spad_count, uint16_t signal_rate_mcps, uint16_t ambient_rate_mcps,
+                                         uint16_t target_rate) {
+  if (spad_count != 0) {
+    // calc total rate per spad
+    uint32_t total_rate_per_spad = (uint32_t)signal_rate_mcps + ambient_rate_mcps;
+
+    // clip to 16 bits
+    if (total_rate_per_spad > 0xFFFF) { total_rate_per_spad = 0xFFFF; }
+
+    // shift up to take advantage of 32 bits
+    total_rate_per_spad <<= 16;
+
+    total_rate_per_spad /= spad_count;
+
+    if (total_rate_per_spad != 0) {
+      // get the target rate and shift up by 16
+      uint32_t required_spads = ((uint32_t)target_rate << 16) / total_rate_per_spad;
+
+      // clip to 16 bit
+      if (required_spads > 0xFFFF) { required_spads = 0xFFFF; }
+
+      return static_cast<uint16_t>(required_spads);
+    }
+  }
+
+  // if we reached this point, it means something above would have resulted in a divide by zero
+  // gracefully set a spad target to mid point
+  return 0x8000;
+}
+
+// whether DSS_CONFIG__MANUAL_EFFECTIVE_SPADS_SELECT should be rewritten with required
+// SPADs, as they differ from the last value written by more than last >> hysteresis_shift
+inline bool dss_change_required(uint16_t last_spads, uint16_t required_spads, uint8_t hysteresis_shift) {
+  uint16_t difference = (required_spads > last_spads) ? required_spads - last_spads : last_spads - required_spads;
+  return difference > (last_spads >> hysteresis_shift);
+}
+
+// decode sequence step timeout in MCLKs from register value
+// based on VL53L1_decode_timeout()
+// encode_timeout() never uses a shift above 24, larger (corrupted) values saturate
+inline uint32_t decode_timeout(uint16_t reg_val) {
+  uint8_t shift = reg_val >> 8;
+  if (shift > 24) shift = 24;
+  return ((uint32_t)(reg_val & 0xFF) << shift) + 1;
+}
+
+// encode sequence step timeout register value from timeout in MCLKs
+// based on VL53L1_encode_timeout()
+inline uint16_t encode_timeout(uint32_t timeout_mclks) {
+  // encoded format: (LSByte * 2^MSByte) + 1
+
+  uint32_t ls_byte = 0;
+  uint16_t ms_byte = 0;
+
+  if (timeout_mclks > 0) {
+    ls_byte = timeout_mclks - 1;
+
+    while ((ls_byte & 0xFFFFFF00) > 0) {
+      ls_byte >>= 1;
+      ms_byte++;
+    }
+
+    return (ms_byte << 8) | (ls_byte & 0xFF);
+  } else {
+    return 0;
+  }
+}
+
+// convert sequence step timeout from macro periods to microseconds with given
+// macro period in microseconds (12.12 format)
+// based on VL53L1_calc_timeout_us()
+inline uint32_t timeout_mclks_to_microseconds(uint32_t timeout_mclks, uint32_t macro_period_us) {
+  return ((uint64_t)timeout_mclks * macro_period_us + 0x800) >> 12;
+}
+
+// convert sequence step timeout from microseconds to macro periods with given
+// macro period in microseconds (12.12 format)
+// based on VL53L1_calc_timeout_mclks()
+// returns 0 for a zero macro period
+inline uint32_t timeout_microseconds_to_mclks(uint32_t timeout_us, uint32_t macro_period_us) {
+  if (macro_period_us == 0) return 0;
+  return static_cast<uint32_t>((((uint64_t)timeout_us << 12) + (macro_period_us >> 1)) / macro_period_us);
+}
+
+// calculate macro period in microseconds (12.12 format) with given VCSEL period
+// and fast oscillator frequency (4.12 format) read from OSC_MEASURED__FAST_OSC__FREQUENCY
+// based on VL53L1_calc_macro_period_us()
+// returns 0 for a zero oscillator frequency, which is never read from a working sensor
+inline uint32_t calculate_macro_period(uint8_t vcsel_period, uint16_t fast_osc_frequency) {
+  if (fast_osc_frequency == 0) return 0;
+
+  // from VL53L1_calc_pll_period_us()
+  // fast osc frequency in 4.12 format; PLL period in 0.24 format
+  uint32_t pll_period_us = ((uint32_t)0x01 << 30) / fast_osc_frequency;
+
+  // from VL53L1_decode_vcsel_period()
+  uint8_t vcsel_period_pclks = (vcsel_period + 1) << 1;
+
+  // VL53L1_MACRO_PERIOD_VCSEL_PERIODS = 2304
+  // 64 bit so a very low (corrupted) oscillator frequency cannot overflow
+  uint64_t macro_period_us = (uint64_t)2304 * pll_period_us;
+  macro_period_us >>= 6;
+  macro_period_us *= vcsel_period_pclks;
+  macro_period_us >>= 6;
+
+  return static_cast<uint32_t>(macro_period_us);
+}
+
+// sort a few distances in place (insertion sort)
+inline void sort_distances(uint16_t *values, uint8_t count) {
+  for (uint8_t i = 1; i < count; i++) {
+    uint16_t value = values[i];
+    uint8_t j = i;
+    while ((j > 0) && (values[j - 1] > value)) {
+      values[j] = values[j - 1];
+      j--;
+    }
+    values[j] = value;
+  }
+}
+
+// median of sorted distances, count must not be 0
+inline uint16_t median_distance(const uint16_t *sorted, uint8_t count) {
+  if (count & 0x01) return sorted[count / 2];
+  return static_cast<uint16_t>(((uint32_t)sorted[count / 2 - 1] + sorted[count / 2] + 1) / 2);
+}
+
+// mean of sorted distances without the lowest and highest quarter, count must not be 0
+inline uint16_t trimmed_mean_distance(const uint16_t *sorted, uint8_t count) {
+  uint8_t trim = count / 4;
+  uint32_t sum = 0;
+  for (uint8_t i = trim; i < count - trim; i++)
+    sum += sorted[i];
+  uint8_t used = count - 2 * trim;
+  return static_cast<uint16_t>((sum + used / 2) / used);
+}
+
+}  // namespace vl53l1x
+}  // namespace esphome
@@ -0,0 +1,525 @@
+// checks the kernels in vl53l1x_calc.h against the member functions they
+// replaced, over the full input ranges, and reports the time per call of both
+// exits non-zero if the two differ anywhere the previous code was defined
+// --quick checks encode_timeout() over every shift and mantissa rather than
+// all 2^32 inputs, and calculate_required_spads() with total rates in steps
+// rather than every one, the full check takes a few minutes
+
+#include "vl53l1x_calc.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace esphome::vl53l1x;
+
+// the previous implementations, as they were in VL53L1XComponent
+// (fast_osc_frequency_ was a member and TARGET_RATE a constant, they are parameters here)
+namespace baseline {
+
+// the fields read_ranging_results() decoded and the state it set from them
+struct Results {
+  uint8_t range_status;
+  uint8_t stream_count;
+  uint16_t dss_actual_effective_spads_sd0;
+  uint16_t ambient_count_rate_mcps_sd0;
+  uint16_t final_crosstalk_corrected_range_mm_sd0;
+  uint16_t peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+  RangeStatus status;
+  uint16_t distance;
+};
+
+RangeStatus map_range_status(uint8_t range_status, uint8_t stream_count) {
+  switch (range_status) {
+    case 9:
+      if (stream_count != 0)
+        return RANGE_VALID;
+      return RANGE_VALID_NOWRAP_CHECK_FAIL;
+    case 8:
+      return RANGE_VALID_MIN_RANGE_CLIPPED;
+    case 1:
+    case 2:
+    case 3:
+    case 17:
+      return HARDWARE_FAIL;
+    case 4:
+      return SIGNAL_FAIL;
+    case 5:
+      return OUT_OF_BOUNDS_FAIL;
+    case 6:
+      return SIGMA_FAIL;
+    case 7:
+      return WRAP_TARGET_FAIL;
+    case 13:
+      return MIN_RANGE_FAIL;
+    default:
+      return UNDEFINED;
+  }
+}
+
+// undefined for a high byte of 32 or more
+uint32_t decode_timeout(uint16_t reg_val) { return ((uint32_t) (reg_val & 0xFF) << (reg_val >> 8)) + 1; }
+
+uint16_t encode_timeout(uint32_t timeout_mclks) {
+  uint32_t ls_byte = 0;
+  uint16_t ms_byte = 0;
+
+  if (timeout_mclks > 0) {
+    ls_byte = timeout_mclks - 1;
+
+    while ((ls_byte & 0xFFFFFF00) > 0) {
+      ls_byte >>= 1;
+      ms_byte++;
+    }
+
+    return (ms_byte << 8) | (ls_byte & 0xFF);
+  } else {
+    return 0;
+  }
+}
+
+uint32_t timeout_mclks_to_microseconds(uint32_t timeout_mclks, uint32_t macro_period_us) {
+  return ((uint64_t) timeout_mclks * macro_period_us + 0x800) >> 12;
+}
+
+// wraps for a timeout of about 2^20us or more, divides by zero for a zero macro period
+uint32_t timeout_microseconds_to_mclks(uint32_t timeout_us, uint32_t macro_period_us) {
+  return (((uint32_t) timeout_us << 12) + (macro_period_us >> 1)) / macro_period_us;
+}
+
+// divides by zero for a zero frequency, wraps for very low frequencies
+uint32_t calculate_macro_period(uint8_t vcsel_period, uint16_t fast_osc_frequency) {
+  uint32_t pll_period_us = ((uint32_t) 0x01 << 30) / fast_osc_frequency;
+
+  uint8_t vcsel_period_pclks = (vcsel_period + 1) << 1;
+
+  uint32_t macro_period_us = (uint32_t) 2304 * pll_period_us;
+  macro_period_us >>= 6;
+  macro_period_us *= vcsel_period_pclks;
+  macro_period_us >>= 6;
+
+  return macro_period_us;
+}
+
+// update_dss() without the register write, returns the value it wrote
+uint16_t required_spads(uint16_t spadCount, uint16_t signal_rate, uint16_t ambient_rate, uint16_t target_rate) {
+  if (spadCount != 0) {
+    // calc total rate per spad
+    uint32_t totalRatePerSpad = (uint32_t) signal_rate + ambient_rate;
+
+    // clip to 16 bits
+    if (totalRatePerSpad > 0xFFFF) { totalRatePerSpad = 0xFFFF; }
+
+    // shift up to take advantage of 32 bits
+    totalRatePerSpad <<= 16;
+
+    totalRatePerSpad /= spadCount;
+
+    if (totalRatePerSpad != 0) {
+      // get the target rate and shift up by 16
+      uint32_t requiredSpads = ((uint32_t) target_rate << 16) / totalRatePerSpad;
+
+      // clip to 16 bit
+      if (requiredSpads > 0xFFFF) { requiredSpads = 0xFFFF; }
+
+      return requiredSpads;
+    }
+  }
+
+  // set target to mid point
+  return 0x8000;
+}
+
+uint16_t apply_range_gain(uint16_t range_mm) {
+  uint32_t range = static_cast<uint32_t>(range_mm);
+  return static_cast<uint16_t>(((range * 2011) + 0x0400) / 0x0800);
+}
+
+// read_ranging_results() without the register read
+void read_ranging_results(const uint8_t *results_buffer, Results *results) {
+  results->range_status = results_buffer[0];
+  results->stream_count = results_buffer[2];
+
+  results->dss_actual_effective_spads_sd0  = (uint16_t)results_buffer[3] << 8 | results_buffer[4];
+  results->ambient_count_rate_mcps_sd0  = (uint16_t)results_buffer[7] << 8 | results_buffer[8];
+
+  results->final_crosstalk_corrected_range_mm_sd0  = (uint16_t)results_buffer[13] << 8 | results_buffer[14];
+  results->peak_signal_count_rate_crosstalk_corrected_mcps_sd0  = (uint16_t)results_buffer[15] << 8 | results_buffer[16];
+
+  results->status = map_range_status(results->range_status, results->stream_count);
+  results->distance = apply_range_gain(results->final_crosstalk_corrected_range_mm_sd0);
+}
+
+}  // namespace baseline
+
+// typical OSC_MEASURED__FAST_OSC__FREQUENCY, 11.8MHz (4.12 format)
+static const uint16_t FAST_OSC_FREQUENCY   = 0xBCCC;
+// timeouts in us whose 12 bit shift fits 32 bits
+static const uint32_t TIMEOUT_US_LIMIT     = 1 << 20;
+// largest shift encode_timeout() produces
+static const uint8_t  TIMEOUT_SHIFT_MAX    = 24;
+// default DSS_CONFIG__TARGET_TOTAL_RATE_MCPS, and the DSS hysteresis used by update_dss()
+static const uint16_t TARGET_RATE          = 0x0A00;
+static const uint8_t  DSS_HYSTERESIS_SHIFT = 4;
+// with --quick, total rates between the edges are checked in steps of this
+static const uint32_t TOTAL_RATE_STEP      = 251;
+// result blocks decoded by the read_ranging_results benchmark
+static const uint32_t RESULT_BUFFERS       = 256;
+
+static uint32_t failures = 0;
+
+static void report(const char *kernel, uint64_t checked, uint64_t mismatched, uint64_t undefined) {
+  printf("%-32s %12llu inputs, %llu differ", kernel, (unsigned long long) checked, (unsigned long long) mismatched);
+  if (undefined != 0)
+    printf(" (%llu where the previous code was undefined or wrapped, not compared)", (unsigned long long) undefined);
+  printf("\n");
+  if (mismatched != 0)
+    failures++;
+}
+
+static void check_map_range_status() {
+  uint64_t checked = 0, mismatched = 0;
+  for (uint32_t status = 0; status <= 0xFF; status++) {
+    for (uint32_t stream_count = 0; stream_count <= 0xFF; stream_count++) {
+      checked++;
+      if (map_range_status(status, stream_count) != baseline::map_range_status(status, stream_count))
+        mismatched++;
+    }
+  }
+  report("map_range_status", checked, mismatched, 0);
+}
+
+static void check_decode_timeout() {
+  uint64_t checked = 0, mismatched = 0, undefined = 0;
+  for (uint32_t reg_val = 0; reg_val <= 0xFFFF; reg_val++) {
+    // above the largest shift the register format is only reached by a corrupted value,
+    // the new code saturates where the previous code wrapped or was undefined
+    if ((reg_val >> 8) > TIMEOUT_SHIFT_MAX) {
+      undefined++;
+      continue;
+    }
+    checked++;
+    if (decode_timeout(reg_val) != baseline::decode_timeout(reg_val))
+      mismatched++;
+  }
+  report("decode_timeout", checked, mismatched, undefined);
+}
+
+static void check_encode_timeout(bool quick) {
+  uint64_t checked = 0, mismatched = 0;
+  if (quick) {
+    // the result depends on the highest set bit of timeout_mclks - 1 and the 7 bits below it,
+    // so check every such prefix with the bits below it clear, set and alternating
+    static const uint32_t LOW_BITS[] = {0x00000000, 0xFFFFFFFF, 0x55555555, 0xAAAAAAAA};
+    for (uint32_t shift = 0; shift < 32; shift++) {
+      for (uint32_t mantissa = 0; mantissa <= 0xFF; mantissa++) {
+        for (uint32_t low : LOW_BITS) {
+          uint32_t low_mask = (shift == 0) ? 0 : (0xFFFFFFFF >> (32 - shift));
+          uint64_t value = ((uint64_t) mantissa << shift) | (low & low_mask);
+          if (value > 0xFFFFFFFE)
+            continue;
+          uint32_t timeout_mclks = value + 1;
+          checked++;
+          if (encode_timeout(timeout_mclks) != baseline::encode_timeout(timeout_mclks))
+            mismatched++;
+        }
+      }
+    }
+    checked++;
+    if (encode_timeout(0) != baseline::encode_timeout(0))
+      mismatched++;
+  } else {
+    uint32_t timeout_mclks = 0;
+    do {
+      checked++;
+      if (encode_timeout(timeout_mclks) != baseline::encode_timeout(timeout_mclks))
+        mismatched++;
+    } while (++timeout_mclks != 0);
+  }
+  report("encode_timeout", checked, mismatched, 0);
+}
+
+static void check_calculate_macro_period() {
+  uint64_t checked = 0, mismatched = 0, undefined = 0;
+  for (uint32_t frequency = 0; frequency <= 0xFFFF; frequency++) {
+    for (uint32_t vcsel_period = 0; vcsel_period <= 0xFF; vcsel_period++) {
+      uint64_t pll_period_us = ((uint64_t) 1 << 30) / (frequency ? frequency : 1);
+      uint8_t vcsel_period_pclks = (vcsel_period + 1) << 1;
+      if ((frequency == 0) || (2304 * pll_period_us > UINT32_MAX) ||
+          (((2304 * pll_period_us) >> 6) * vcsel_period_pclks > UINT32_MAX)) {
+        undefined++;
+        continue;
+      }
+      checked++;
+      if (calculate_macro_period(vcsel_period, frequency) != baseline::calculate_macro_period(vcsel_period, frequency))
+        mismatched++;
+    }
+  }
+  report("calculate_macro_period", checked, mismatched, undefined);
+}
+
+// signal plus ambient rate, which is all the result depends on besides the SPAD count,
+// from 0 to where both are 0xFFFF, every value near 0 and where the sum is clipped
+static std::vector<uint32_t> total_rates(bool quick) {
+  std::vector<uint32_t> rates;
+  for (uint32_t total = 0; total <= 0x1FFFE; total++) {
+    bool edge = (total < 0x100) || ((total >= 0xFF00) && (total <= 0x100FF)) || (total >= 0x1FF00);
+    if (!quick || edge || (total % TOTAL_RATE_STEP == 0))
+      rates.push_back(total);
+  }
+  return rates;
+}
+
+// calculate_required_spads() against update_dss(), over every SPAD count including 0,
+// total rates including 0 and target rates including the default
+static void check_calculate_required_spads(bool quick) {
+  static const uint16_t TARGET_RATES[] = {TARGET_RATE, 0, 1, 0x7FFF, 0xFFFF};
+  std::vector<uint32_t> rates = total_rates(quick);
+
+  uint64_t checked = 0, mismatched = 0;
+  for (uint16_t target_rate : TARGET_RATES) {
+    for (uint32_t spad_count = 0; spad_count <= 0xFFFF; spad_count++) {
+      for (uint32_t total : rates) {
+        uint16_t signal_rate = (total > 0xFFFF) ? 0xFFFF : total;
+        uint16_t ambient_rate = total - signal_rate;
+        checked++;
+        if (calculate_required_spads(spad_count, signal_rate, ambient_rate, target_rate) !=
+            baseline::required_spads(spad_count, signal_rate, ambient_rate, target_rate))
+          mismatched++;
+      }
+    }
+    // in full mode only the default target rate is checked over every total rate
+    if (!quick)
+      break;
+  }
+  report("calculate_required_spads", checked, mismatched, 0);
+}
+
+// update_dss() wrote every frame, dss_change_required() skips the write unless the
+// required SPADs differ by more than the hysteresis, checked on each side of it
+static void check_dss_change_required() {
+  uint64_t checked = 0, mismatched = 0;
+  for (uint8_t shift = 0; shift < 16; shift++) {
+    for (int32_t last = 0; last <= 0xFFFF; last++) {
+      int32_t threshold = last >> shift;
+      const int32_t required[] = {0, last - threshold - 1, last - threshold, last, last + threshold,
+                                  last + threshold + 1, 0xFFFF};
+      for (int32_t spads : required) {
+        if ((spads < 0) || (spads > 0xFFFF))
+          continue;
+        checked++;
+        if (dss_change_required(last, spads, shift) != (abs(spads - last) > threshold))
+          mismatched++;
+      }
+    }
+  }
+  report("dss_change_required (hysteresis)", checked, mismatched, 0);
+}
+
+static void check_apply_range_gain() {
+  uint64_t checked = 0, mismatched = 0;
+  for (uint32_t range_mm = 0; range_mm <= 0xFFFF; range_mm++) {
+    checked++;
+    if (apply_range_gain(range_mm) != baseline::apply_range_gain(range_mm))
+      mismatched++;
+  }
+  report("apply_range_gain", checked, mismatched, 0);
+}
+
+// decode_ranging_results(), map_range_status() and apply_range_gain() against
+// read_ranging_results(), with every value of each byte of the result block
+static void check_decode_ranging_results() {
+  static const uint8_t BACKGROUNDS[] = {0x00, 0xFF, 0x55, 0xAA};
+  uint64_t checked = 0, mismatched = 0;
+  for (uint8_t background : BACKGROUNDS) {
+    for (uint8_t position = 0; position < RANGING_RESULTS_SIZE; position++) {
+      for (uint32_t value = 0; value <= 0xFF; value++) {
+        uint8_t buffer[RANGING_RESULTS_SIZE];
+        memset(buffer, background, sizeof(buffer));
+        buffer[position] = value;
+
+        RangingResults results;
+        decode_ranging_results(buffer, &results);
+        baseline::Results expected;
+        baseline::read_ranging_results(buffer, &expected);
+        checked++;
+        if ((results.range_status != expected.range_status) || (results.stream_count != expected.stream_count) ||
+            (results.dss_actual_effective_spads_sd0 != expected.dss_actual_effective_spads_sd0) ||
+            (results.ambient_count_rate_mcps_sd0 != expected.ambient_count_rate_mcps_sd0) ||
+            (results.final_crosstalk_corrected_range_mm_sd0 != expected.final_crosstalk_corrected_range_mm_sd0) ||
+            (results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0 !=
+             expected.peak_signal_count_rate_crosstalk_corrected_mcps_sd0) ||
+            (map_range_status(results.range_status, results.stream_count) != expected.status) ||
+            (apply_range_gain(results.final_crosstalk_corrected_range_mm_sd0) != expected.distance))
+          mismatched++;
+      }
+    }
+  }
+  report("read_ranging_results", checked, mismatched, 0);
+}
+
+// every macro period a sensor with a typical oscillator reports
+static std::vector<uint32_t> macro_periods() {
+  std::vector<uint32_t> periods;
+  for (uint32_t vcsel_period = 0; vcsel_period <= 0xFF; vcsel_period++) {
+    uint32_t period = calculate_macro_period(vcsel_period, FAST_OSC_FREQUENCY);
+    if (period != 0)
+      periods.push_back(period);
+  }
+  return periods;
+}
+
+static void check_timeout_conversions() {
+  std::vector<uint32_t> periods = macro_periods();
+
+  uint64_t checked = 0, mismatched = 0, undefined = 0;
+  for (uint32_t period : periods) {
+    for (uint32_t timeout_us = 0; timeout_us < TIMEOUT_US_LIMIT; timeout_us++) {
+      // the previous code also wrapped adding half the period for the longest timeouts
+      if (((uint64_t) timeout_us << 12) + (period >> 1) > UINT32_MAX) {
+        undefined++;
+        continue;
+      }
+      checked++;
+      if (timeout_microseconds_to_mclks(timeout_us, period) != baseline::timeout_microseconds_to_mclks(timeout_us, period))
+        mismatched++;
+    }
+  }
+  report("timeout_microseconds_to_mclks", checked, mismatched, undefined);
+
+  checked = 0;
+  mismatched = 0;
+  for (uint32_t period : periods) {
+    for (uint32_t reg_val = 0; reg_val < (uint32_t) (TIMEOUT_SHIFT_MAX + 1) << 8; reg_val++) {
+      uint32_t timeout_mclks = decode_timeout(reg_val);
+      checked++;
+      if (timeout_mclks_to_microseconds(timeout_mclks, period) !=
+          baseline::timeout_mclks_to_microseconds(timeout_mclks, period))
+        mismatched++;
+    }
+  }
+  report("timeout_mclks_to_microseconds", checked, mismatched, 0);
+}
+
+static volatile uint32_t benchmark_sink;
+
+// time per call of kernel over count inputs generated from the index
+template<typename F> static double time_per_call(uint32_t count, F kernel) {
+  uint32_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; i++)
+    sum += kernel(i);
+  auto end = std::chrono::steady_clock::now();
+  benchmark_sink = sum;
+  return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+static const uint32_t BENCHMARK_CALLS  = 1 << 22;
+static const uint8_t  BENCHMARK_ROUNDS = 5;
+
+template<typename F, typename G> static void benchmark(const char *kernel, F current, G previous) {
+  // best of alternating rounds, so neither is favoured by warm up or a busy machine
+  double current_ns = 1e9, previous_ns = 1e9;
+  for (uint8_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    double ns = time_per_call(BENCHMARK_CALLS, current);
+    if (ns < current_ns)
+      current_ns = ns;
+    ns = time_per_call(BENCHMARK_CALLS, previous);
+    if (ns < previous_ns)
+      previous_ns = ns;
+  }
+  printf("%-32s %8.2f ns/call (previous %.2f ns/call)\n", kernel, current_ns, previous_ns);
+}
+
+static void run_benchmarks() {
+  std::vector<uint32_t> periods = macro_periods();
+  size_t period_count = periods.size();
+  std::vector<uint8_t> buffers(RESULT_BUFFERS * RANGING_RESULTS_SIZE);
+  std::minstd_rand random(5489);
+  for (uint8_t &byte : buffers)
+    byte = random();
+
+  benchmark(
+      "map_range_status", [](uint32_t i) { return (uint32_t) map_range_status(i & 0x1F, i >> 5); },
+      [](uint32_t i) { return (uint32_t) baseline::map_range_status(i & 0x1F, i >> 5); });
+  benchmark(
+      "decode_timeout", [](uint32_t i) { return decode_timeout(i % ((TIMEOUT_SHIFT_MAX + 1) << 8)); },
+      [](uint32_t i) { return baseline::decode_timeout(i % ((TIMEOUT_SHIFT_MAX + 1) << 8)); });
+  benchmark(
+      "encode_timeout", [](uint32_t i) { return (uint32_t) encode_timeout(i * 2654435761u); },
+      [](uint32_t i) { return (uint32_t) baseline::encode_timeout(i * 2654435761u); });
+  benchmark(
+      "calculate_macro_period", [](uint32_t i) { return calculate_macro_period(i, FAST_OSC_FREQUENCY + ((i >> 8) & 0xFFF)); },
+      [](uint32_t i) { return baseline::calculate_macro_period(i, FAST_OSC_FREQUENCY + ((i >> 8) & 0xFFF)); });
+  benchmark(
+      "timeout_microseconds_to_mclks",
+      [&](uint32_t i) { return timeout_microseconds_to_mclks(i % TIMEOUT_US_LIMIT, periods[i % period_count]); },
+      [&](uint32_t i) {
+        return baseline::timeout_microseconds_to_mclks(i % TIMEOUT_US_LIMIT, periods[i % period_count]);
+      });
+  benchmark(
+      "timeout_mclks_to_microseconds",
+      [&](uint32_t i) { return timeout_mclks_to_microseconds(i, periods[i % period_count]); },
+      [&](uint32_t i) { return baseline::timeout_mclks_to_microseconds(i, periods[i % period_count]); });
+  // SPAD counts and rates as frames report them, the target rate at its default
+  benchmark(
+      "calculate_required_spads",
+      [](uint32_t i) { return (uint32_t) calculate_required_spads(i & 0x3FFF, i >> 18, (i >> 4) & 0x3FFF, TARGET_RATE); },
+      [](uint32_t i) { return (uint32_t) baseline::required_spads(i & 0x3FFF, i >> 18, (i >> 4) & 0x3FFF, TARGET_RATE); });
+  // the arithmetic of update_dss(), which now also decides whether to write
+  benchmark(
+      "update_dss",
+      [](uint32_t i) {
+        uint16_t required = calculate_required_spads(i & 0x3FFF, i >> 18, (i >> 4) & 0x3FFF, TARGET_RATE);
+        return (uint32_t) dss_change_required(0x8000 - (i & 0xFFF), required, DSS_HYSTERESIS_SHIFT);
+      },
+      [](uint32_t i) { return (uint32_t) baseline::required_spads(i & 0x3FFF, i >> 18, (i >> 4) & 0x3FFF, TARGET_RATE); });
+  benchmark(
+      "apply_range_gain", [](uint32_t i) { return (uint32_t) apply_range_gain(i); },
+      [](uint32_t i) { return (uint32_t) baseline::apply_range_gain(i); });
+  // decoding a result block into the state read_ranging_results() set
+  benchmark(
+      "read_ranging_results",
+      [&](uint32_t i) {
+        RangingResults results;
+        decode_ranging_results(&buffers[(i % RESULT_BUFFERS) * RANGING_RESULTS_SIZE], &results);
+        return (uint32_t) map_range_status(results.range_status, results.stream_count) +
+               apply_range_gain(results.final_crosstalk_corrected_range_mm_sd0) +
+               results.dss_actual_effective_spads_sd0 + results.ambient_count_rate_mcps_sd0 +
+               results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+      },
+      [&](uint32_t i) {
+        baseline::Results results;
+        baseline::read_ranging_results(&buffers[(i % RESULT_BUFFERS) * RANGING_RESULTS_SIZE], &results);
+        return (uint32_t) results.status + results.distance + results.dss_actual_effective_spads_sd0 +
+               results.ambient_count_rate_mcps_sd0 + results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0;
+      });
+}
+
+int main(int argc, char **argv) {
+  bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+  setvbuf(stdout, nullptr, _IONBF, 0);
+  printf("Equivalence with the previous implementation:\n");
+  check_map_range_status();
+  check_decode_timeout();
+  check_encode_timeout(quick);
+  check_calculate_macro_period();
+  check_timeout_conversions();
+  check_calculate_required_spads(quick);
+  check_dss_change_required();
+  check_apply_range_gain();
+  check_decode_ranging_results();
+
+  printf("\nTime per call:\n");
+  run_benchmarks();
+
+  if (failures != 0) {
+    printf("\n%u kernels differ from the previous implementation\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+// libFuzzer target for the kernels that turn raw sensor bytes into state
+// and register writes: result decoding, range status mapping, DSS and the
+// timeout encode/decode helpers
+
+#include "vl53l1x_calc.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+using namespace esphome::vl53l1x;
+
+// result block, then DSS target rate, timeout register, VCSEL period,
+// oscillator frequency and timeout in us, as a corrupted frame could deliver them
+static const size_t FUZZ_INPUT_SIZE = RANGING_RESULTS_SIZE + 2 + 2 + 1 + 2 + 4;
+
+static uint16_t read_u16(const uint8_t *data) { return (uint16_t) data[0] << 8 | data[1]; }
+
+static uint32_t read_u32(const uint8_t *data) { return (uint32_t) read_u16(data) << 16 | read_u16(data + 2); }
+
+#define FUZZ_CHECK(condition) \
+  do { \
+    if (!(condition)) \
+      abort(); \
+  } while (0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  // short inputs are zero padded so every path runs on every input
+  uint8_t input[FUZZ_INPUT_SIZE] = {0};
+  memcpy(input, data, size < FUZZ_INPUT_SIZE ? size : FUZZ_INPUT_SIZE);
+  const uint8_t *next = input;
+
+  RangingResults results;
+  decode_ranging_results(next, &results);
+  next += RANGING_RESULTS_SIZE;
+
+  RangeStatus status = map_range_status(results.range_status, results.stream_count);
+  FUZZ_CHECK(status <= UNDEFINED);
+  FUZZ_CHECK(apply_range_gain(results.final_crosstalk_corrected_range_mm_sd0) <=
+             results.final_crosstalk_corrected_range_mm_sd0);
+
+  uint16_t target_rate = read_u16(next);
+  next += 2;
+  uint16_t required = calculate_required_spads(results.dss_actual_effective_spads_sd0,
+                                               results.peak_signal_count_rate_crosstalk_corrected_mcps_sd0,
+                                               results.ambient_count_rate_mcps_sd0, target_rate);
+  // no SPAD count or rate to divide by falls back to the mid point
+  FUZZ_CHECK(results.dss_actual_effective_spads_sd0 != 0 || required == 0x8000);
+  for (uint8_t shift = 0; shift < 16; shift++)
+    dss_change_required(results.dss_actual_effective_spads_sd0, required, shift);
+
+  uint16_t timeout_reg = read_u16(next);
+  next += 2;
+  uint32_t mclks = decode_timeout(timeout_reg);
+  FUZZ_CHECK(mclks != 0);
+  // encoding loses only the bits the register format cannot hold
+  FUZZ_CHECK(decode_timeout(encode_timeout(mclks)) == mclks);
+
+  uint8_t vcsel_period = *next++;
+  uint16_t fast_osc_frequency = read_u16(next);
+  next += 2;
+  uint32_t timeout_us = read_u32(next);
+  uint32_t macro_period_us = calculate_macro_period(vcsel_period, fast_osc_frequency);
+  timeout_mclks_to_microseconds(mclks, macro_period_us);
+  uint32_t timeout_mclks = timeout_microseconds_to_mclks(timeout_us, macro_period_us);
+  FUZZ_CHECK(macro_period_us != 0 || timeout_mclks == 0);
+  encode_timeout(timeout_mclks);
+  return 0;
+}
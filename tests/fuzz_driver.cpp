@@ -0,0 +1,44 @@
+// runs a libFuzzer target without libFuzzer, for compilers that lack it:
+// replays each file given on the command line, or with no arguments runs
+// a fixed number of pseudo random inputs from a fixed seed
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const uint32_t RANDOM_RUNS     = 2000000;
+static const size_t   RANDOM_MAX_SIZE = 64;
+static const uint32_t RANDOM_SEED     = 5489;
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      std::ifstream file(argv[i], std::ios::binary);
+      if (!file) {
+        fprintf(stderr, "Cannot read %s\n", argv[i]);
+        return 1;
+      }
+      std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    printf("Replayed %d inputs\n", argc - 1);
+    return 0;
+  }
+
+  std::mt19937 generator(RANDOM_SEED);
+  std::vector<uint8_t> input(RANDOM_MAX_SIZE);
+  for (uint32_t run = 0; run < RANDOM_RUNS; run++) {
+    size_t size = generator() % (RANDOM_MAX_SIZE + 1);
+    for (size_t i = 0; i < size; i++)
+      input[i] = static_cast<uint8_t>(generator());
+    LLVMFuzzerTestOneInput(input.data(), size);
+  }
+  printf("Ran %u random inputs\n", RANDOM_RUNS);
+  return 0;
+}
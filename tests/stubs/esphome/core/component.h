@@ -0,0 +1,42 @@
+#pragma once
+// stand-in for ESPHome's component.h, with only what the component uses
+
+#include <cstdint>
+
+namespace esphome {
+
+namespace setup_priority {
+extern const float DATA;
+}  // namespace setup_priority
+
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual void on_shutdown() {}
+  virtual float get_setup_priority() const { return 0.0f; }
+
+  void mark_failed() { this->failed_ = true; }
+  bool is_failed() const { return this->failed_; }
+  void status_set_warning() { this->warning_ = true; }
+  void status_clear_warning() { this->warning_ = false; }
+  bool status_has_warning() const { return this->warning_; }
+
+ protected:
+  bool failed_{false};
+  bool warning_{false};
+};
+
+class PollingComponent : public Component {
+ public:
+  virtual void update() = 0;
+  void set_update_interval(uint32_t update_interval) { this->update_interval_ = update_interval; }
+  uint32_t get_update_interval() const { return this->update_interval_; }
+
+ protected:
+  uint32_t update_interval_{0};
+};
+
+}  // namespace esphome
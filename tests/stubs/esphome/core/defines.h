@@ -0,0 +1,3 @@
+#pragma once
+// stand-in for the defines.h generated by ESPHome, the host tests
+// select the component options on the compiler command line
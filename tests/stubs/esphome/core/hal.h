@@ -0,0 +1,15 @@
+#pragma once
+// stand-in for ESPHome's hal.h, time is simulated and only moves when
+// the test or the component delays (see host_support.h)
+
+#include <cstdint>
+
+namespace esphome {
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+}  // namespace esphome
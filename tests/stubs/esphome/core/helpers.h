@@ -0,0 +1,58 @@
+#pragma once
+// stand-in for ESPHome's helpers.h, with only what the component uses
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+
+uint32_t fnv1_hash(const std::string &str);
+std::string format_hex_pretty(const uint8_t *data, size_t length);
+
+template<typename T> constexpr T convert_big_endian(T val) { return (val >> 8) | (val << 8); }
+
+class HighFrequencyLoopRequester {
+ public:
+  void start() {}
+  void stop() {}
+};
+
+template<typename... X> class CallbackManager;
+template<typename... Ts> class CallbackManager<void(Ts...)> {
+ public:
+  void add(std::function<void(Ts...)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+  void call(Ts... args) {
+    for (auto &callback : this->callbacks_)
+      callback(args...);
+  }
+
+ protected:
+  std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+class Mutex {
+ public:
+  void lock() { this->mutex_.lock(); }
+  bool try_lock() { return this->mutex_.try_lock(); }
+  void unlock() { this->mutex_.unlock(); }
+
+ protected:
+  std::mutex mutex_;
+};
+
+class LockGuard {
+ public:
+  LockGuard(Mutex &mutex) : mutex_(mutex) { mutex_.lock(); }
+  ~LockGuard() { mutex_.unlock(); }
+
+ protected:
+  Mutex &mutex_;
+};
+
+}  // namespace esphome
@@ -0,0 +1,32 @@
+#pragma once
+// stand-in for ESPHome's log.h, every message goes to host_log() so a test
+// can capture the very verbose register trace
+
+#include <cstdio>
+
+namespace esphome {
+
+enum HostLogLevel {
+  HOST_LOG_ERROR = 1,
+  HOST_LOG_WARN,
+  HOST_LOG_INFO,
+  HOST_LOG_CONFIG,
+  HOST_LOG_DEBUG,
+  HOST_LOG_VERBOSE,
+  HOST_LOG_VERY_VERBOSE,
+};
+
+void host_log(HostLogLevel level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+}  // namespace esphome
+
+#define ESP_LOGE(tag, ...) esphome::host_log(esphome::HOST_LOG_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) esphome::host_log(esphome::HOST_LOG_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) esphome::host_log(esphome::HOST_LOG_INFO, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) esphome::host_log(esphome::HOST_LOG_CONFIG, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) esphome::host_log(esphome::HOST_LOG_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) esphome::host_log(esphome::HOST_LOG_VERBOSE, tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) esphome::host_log(esphome::HOST_LOG_VERY_VERBOSE, tag, __VA_ARGS__)
+#define LOG_UPDATE_INTERVAL(this)
+#define ONOFF(b) ((b) ? "ON" : "OFF")
+#define YESNO(b) ((b) ? "YES" : "NO")
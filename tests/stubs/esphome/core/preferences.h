@@ -0,0 +1,47 @@
+#pragma once
+// stand-in for ESPHome's preferences.h, keeping each preference in memory
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace esphome {
+
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t> *store) : store_(store) {}
+
+  template<typename T> bool save(const T *src) {
+    if (this->store_ == nullptr)
+      return false;
+    this->store_->assign(reinterpret_cast<const uint8_t *>(src), reinterpret_cast<const uint8_t *>(src) + sizeof(T));
+    return true;
+  }
+
+  template<typename T> bool load(T *dest) {
+    if ((this->store_ == nullptr) || (this->store_->size() != sizeof(T)))
+      return false;
+    memcpy(dest, this->store_->data(), sizeof(T));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *store_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type) {
+    return ESPPreferenceObject(&this->stores_[type]);
+  }
+  void clear() { this->stores_.clear(); }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> stores_;
+};
+
+extern ESPPreferences *global_preferences;
+
+}  // namespace esphome
@@ -0,0 +1,70 @@
+// implementation of the ESPHome stand-ins used by the host tests
+
+#include "host_support.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/preferences.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace esphome {
+
+static uint64_t now_us = 0;
+
+uint32_t micros() { return static_cast<uint32_t>(now_us); }
+uint32_t millis() { return static_cast<uint32_t>(now_us / 1000); }
+void delay(uint32_t ms) { now_us += (uint64_t) ms * 1000; }
+void delayMicroseconds(uint32_t us) { now_us += us; }
+void yield() {}
+void advance_time_us(uint32_t us) { now_us += us; }
+
+static std::function<void(HostLogLevel, const std::string &)> log_listener;
+
+void set_log_listener(std::function<void(HostLogLevel level, const std::string &message)> &&listener) {
+  log_listener = std::move(listener);
+}
+
+void host_log(HostLogLevel level, const char *tag, const char *format, ...) {
+  char message[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  if (log_listener) {
+    log_listener(level, message);
+  } else if (level <= HOST_LOG_WARN) {
+    printf("[%s] %s\n", tag, message);
+  }
+}
+
+namespace setup_priority {
+const float DATA = 600.0f;
+}  // namespace setup_priority
+
+uint32_t fnv1_hash(const std::string &str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= c;
+  }
+  return hash;
+}
+
+std::string format_hex_pretty(const uint8_t *data, size_t length) {
+  std::string result;
+  char hex[4];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(hex, sizeof(hex), (i == 0) ? "%02X" : ".%02X", data[i]);
+    result += hex;
+  }
+  if (length > 4)
+    result += " (" + std::to_string(length) + ")";
+  return result;
+}
+
+static ESPPreferences preferences;
+ESPPreferences *global_preferences = &preferences;
+
+}  // namespace esphome
@@ -0,0 +1,18 @@
+#pragma once
+// control of the ESPHome stand-ins from the host tests
+
+#include "esphome/core/log.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome {
+
+// move simulated time on, as the main loop would between calls
+void advance_time_us(uint32_t us);
+
+// receives every log message, by default errors and warnings are printed
+void set_log_listener(std::function<void(HostLogLevel level, const std::string &message)> &&listener);
+
+}  // namespace esphome
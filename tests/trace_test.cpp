@@ -0,0 +1,254 @@
+// golden register traces, register images and bus budgets
+// runs the component against the simulated sensor, captures the register
+// transactions of setup, one frame and each runtime action from the very
+// verbose trace in vl53l1x_write_bytes()/vl53l1x_read_bytes(), compares them
+// and the simulated sensor's registers after each operation with those checked
+// in under traces/, and fails if an operation uses more transactions or bytes
+// than its budget
+// trace_test --update rewrites the checked in files after an intended change
+
+#include "vl53l1x.h"
+#include "host_support.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::vl53l1x;
+
+struct Budget {
+  const char *operation;
+  uint16_t transactions;
+  uint16_t bytes;
+};
+
+// raise a budget only together with the trace that needs it
+static const Budget BUDGETS[] = {
+    {"setup", 44, 61},
+    {"frame", 14, 31},
+    {"set_distance_mode", 16, 22},
+    {"set_timing_budget", 11, 15},
+    {"set_roi", 6, 6},
+    {"set_thresholds", 6, 8},
+};
+
+static const uint32_t LOOP_INTERVAL_US = 1000;
+// most loop() calls for a frame to complete
+static const uint32_t FRAME_LOOPS      = 2000;
+// loop() calls allowed for a runtime action to be applied
+static const uint32_t ACTION_LOOPS     = 5;
+
+class TraceRecorder {
+ public:
+  TraceRecorder() {
+    set_log_listener([this](HostLogLevel level, const std::string &message) { this->log(level, message); });
+  }
+
+  void start() {
+    this->lines_.clear();
+    this->transactions_ = 0;
+    this->bytes_ = 0;
+  }
+
+  std::string trace() const {
+    std::string trace;
+    for (const std::string &line : this->lines_)
+      trace += line + "\n";
+    return trace;
+  }
+  uint32_t transactions() const { return this->transactions_; }
+  uint32_t bytes() const { return this->bytes_; }
+
+ protected:
+  // "I2C W 0x0086: 01" is traced as written, the data of "I2C R 0x0089: 09.00... (17)"
+  // comes from the simulated sensor, so a read is traced by its length only
+  void log(HostLogLevel level, const std::string &message) {
+    if (level <= HOST_LOG_WARN)
+      printf("  log: %s\n", message.c_str());
+    if ((level != HOST_LOG_VERY_VERBOSE) || (message.compare(0, 4, "I2C ") != 0))
+      return;
+    bool write = message[4] == 'W';
+    std::string address = message.substr(6, 6);
+    std::string data = message.substr(14);
+    size_t suffix = data.find(' ');
+    if (suffix != std::string::npos)
+      data.erase(suffix);
+    uint32_t length = data.empty() ? 0 : 1;
+    for (char c : data)
+      length += (c == '.');
+
+    this->transactions_++;
+    this->bytes_ += length;
+    if (write) {
+      this->lines_.push_back("W " + address + " " + data);
+    } else {
+      this->lines_.push_back("R " + address + " [" + std::to_string(length) + "]");
+    }
+  }
+
+  std::vector<std::string> lines_;
+  uint32_t transactions_{0};
+  uint32_t bytes_{0};
+};
+
+static bool update_traces = false;
+static uint32_t failures = 0;
+
+static std::string golden_path(const std::string &name) { return std::string(TRACE_DIR) + "/" + name + ".txt"; }
+
+// registers in rows of 16, rows which are all zero are left out
+static std::string register_image(const SimulatedSensor &sensor) {
+  std::string image;
+  char text[8];
+  for (uint16_t row = 0; row < SIMULATED_REGISTERS; row += 16) {
+    std::string line;
+    bool zero = true;
+    for (uint16_t i = 0; i < 16; i++) {
+      uint8_t value = sensor.get_register(row + i);
+      zero = zero && (value == 0);
+      snprintf(text, sizeof(text), " %02X", value);
+      line += text;
+    }
+    if (zero)
+      continue;
+    snprintf(text, sizeof(text), "0x%04X:", row);
+    image += text + line + "\n";
+  }
+  return image;
+}
+
+// compares actual with the checked in file, or rewrites the file with --update
+// reports the first line that differs
+static bool compare_golden(const std::string &name, const std::string &actual) {
+  if (update_traces) {
+    std::ofstream(golden_path(name)) << actual;
+    return true;
+  }
+  std::stringstream expected;
+  expected << std::ifstream(golden_path(name)).rdbuf();
+  if (expected.str() == actual)
+    return true;
+
+  std::istringstream expected_lines(expected.str()), actual_lines(actual);
+  std::string expected_line, actual_line;
+  uint32_t line = 0;
+  while (true) {
+    line++;
+    bool more_expected = static_cast<bool>(std::getline(expected_lines, expected_line));
+    bool more_actual = static_cast<bool>(std::getline(actual_lines, actual_line));
+    if (!more_expected)
+      expected_line = "(end of file)";
+    if (!more_actual)
+      actual_line = "(end of file)";
+    if ((expected_line != actual_line) || (!more_expected && !more_actual))
+      break;
+  }
+  printf(" - differs from %s at line %u: expected \"%s\", got \"%s\"", golden_path(name).c_str(), line,
+         expected_line.c_str(), actual_line.c_str());
+  return false;
+}
+
+// the trace and bus cost of the operation, and the registers it left
+static void check(const char *operation, const TraceRecorder &recorder, const VL53L1XComponent &component) {
+  const Budget *budget = nullptr;
+  for (const Budget &entry : BUDGETS) {
+    if (strcmp(entry.operation, operation) == 0)
+      budget = &entry;
+  }
+
+  printf("%-20s %3u transactions, %3u bytes", operation, recorder.transactions(), recorder.bytes());
+  bool ok = true;
+  if ((budget == nullptr) || (recorder.transactions() > budget->transactions) || (recorder.bytes() > budget->bytes)) {
+    printf(" - over budget of %u transactions, %u bytes", budget ? budget->transactions : 0, budget ? budget->bytes : 0);
+    ok = false;
+  }
+
+  if (!compare_golden(operation, recorder.trace()))
+    ok = false;
+  if (!compare_golden(std::string(operation) + "_registers", register_image(component.get_simulated_sensor())))
+    ok = false;
+  printf("%s\n", ok ? "" : " FAILED");
+  if (!ok)
+    failures++;
+}
+
+static void run_loops(VL53L1XComponent *component, uint32_t loops) {
+  for (uint32_t i = 0; i < loops; i++) {
+    component->loop();
+    advance_time_us(LOOP_INTERVAL_US);
+  }
+}
+
+static bool run_frame(VL53L1XComponent *component, sensor::Sensor *distance) {
+  uint32_t published = distance->publish_count;
+  component->update();
+  for (uint32_t i = 0; (i < FRAME_LOOPS) && (distance->publish_count == published); i++) {
+    component->loop();
+    advance_time_us(LOOP_INTERVAL_US);
+  }
+  return distance->publish_count != published;
+}
+
+int main(int argc, char **argv) {
+  update_traces = (argc > 1) && (strcmp(argv[1], "--update") == 0);
+  TraceRecorder recorder;
+
+  VL53L1XComponent component;
+  sensor::Sensor distance;
+  component.set_distance_sensor(&distance);
+  component.set_update_interval(1000);
+  component.config_preset(PRESET_LOW_POWER);
+  component.config_distance_mode(LONG);
+  component.config_timing_budget(100);
+  component.config_simulation(false, 1000, 0, 10000, 0, 0.0f, 0.0f, 1.0f);
+
+  recorder.start();
+  component.setup();
+  check("setup", recorder, component);
+  if (component.is_failed()) {
+    printf("Setup failed\n");
+    return 1;
+  }
+
+  recorder.start();
+  if (!run_frame(&component, &distance)) {
+    printf("No distance published\n");
+    failures++;
+  }
+  check("frame", recorder, component);
+
+  recorder.start();
+  component.request_distance_mode(SHORT);
+  run_loops(&component, ACTION_LOOPS);
+  check("set_distance_mode", recorder, component);
+
+  recorder.start();
+  component.request_timing_budget(200);
+  run_loops(&component, ACTION_LOOPS);
+  check("set_timing_budget", recorder, component);
+
+  recorder.start();
+  component.request_roi(8, 8, 199);
+  run_loops(&component, ACTION_LOOPS);
+  check("set_roi", recorder, component);
+
+  recorder.start();
+  component.request_thresholds(60.0f, 2.0f);
+  run_loops(&component, ACTION_LOOPS);
+  check("set_thresholds", recorder, component);
+
+  if (update_traces) {
+    printf("Traces written to %s\n", TRACE_DIR);
+    return 0;
+  }
+  if (failures != 0) {
+    printf("%u operations failed, if the change is intended update the budgets and run trace_test --update\n",
+           failures);
+    return 1;
+  }
+  return 0;
+}